@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include "allo.h"
 
 #include <stdbool.h>
@@ -6,10 +7,19 @@
 #include <stdio.h>
 #include <string.h>
 #include <sys/mman.h>
+#include <time.h>
 #include <assert.h>
+#include <errno.h>
 
 #include "avl_tree/avl_tree.h"
+#include "pagemap.h"
+#include "numa.h"
+#include "persistent.h"
+#include "tlsf/tlsf.h"
 #include "stats.h"
+#include "percpu.h"
+#include "tcache.h"
+#include "thread_allocator.h"
 
 #ifdef __ALLO_DEBUG_PRINT
 #include <stdarg.h>
@@ -34,22 +44,38 @@ void debug_printf(const char *fmt, ...) {
     } while (0)
 #endif
 
-chunk *to_chunk(void *p) { return (chunk *)((char *)p - sizeof(chunk)); }
+_Static_assert(HEAP_SIZE <= 1 << (TLSF_FL_COUNT + TLSF_FL_SHIFT - 1),
+               "TLSF_FL_COUNT too small for HEAP_SIZE");
+_Static_assert(sizeof(heap) % CHUNK_SIZE_ALIGN == 0
+                   && sizeof(heap_chunk) % CHUNK_SIZE_ALIGN == 0,
+               "heap chunks must stay CHUNK_SIZE_ALIGN aligned");
+
+// index of free heap chunks, best fit search without removing
+#ifdef ALLO_TLSF
+#define free_index_init(a) tlsf_init(&(a)->tlsf)
+#define free_index_search(a, size) tlsf_search(&(a)->tlsf, size)
+#define free_index_insert(a, c) tlsf_insert(&(a)->tlsf, c)
+#define free_index_remove(a, c) tlsf_remove(&(a)->tlsf, c)
+#define free_index_contains(a, c) tlsf_contains(&(a)->tlsf, c)
+#define free_index_debug_print(a) tlsf_debug_print(&(a)->tlsf)
+#else
+#define free_index_init(a) ((a)->free_chunk_tree = NULL)
+#define free_index_search(a, size) avl_tree_search((a)->free_chunk_tree, size)
+#define free_index_insert(a, c)                                                \
+    ((a)->free_chunk_tree =                                                    \
+         avl_tree_insert((a)->free_chunk_tree, (free_chunk_tree *)(c)))
+#define free_index_remove(a, c)                                                \
+    ((a)->free_chunk_tree = avl_tree_remove_node((a)->free_chunk_tree, c))
+#define free_index_contains(a, c) avl_tree_contains((a)->free_chunk_tree, c)
+#define free_index_debug_print(a) avl_tree_debug_print((a)->free_chunk_tree)
+#endif
 
 heap_chunk *to_heap_chunk(void *p) {
     return (heap_chunk *)((char *)p - sizeof(heap_chunk));
 }
 
-heap *get_heap(allocator *a, void *p) {
-    uint64_t addr = (uint64_t)p;
-    for (heap *h = a->heaps; h != NULL; h = h->next) {
-        if ((uint64_t)h->free_chunks <= addr && addr < h->end_of_heap)
-            return h;
-
-        /* debug_assert(addr < (uint64_t)h || addr >= h->end_of_heap); */
-    }
-    return NULL;
-}
+// any pointer into the chunks of a heap, heaps are HEAP_SIZE aligned
+heap *heap_of(void *p) { return (heap *)((uint64_t)p & ~(HEAP_SIZE - 1)); }
 
 void free_chunk_init(free_chunk *res, size_t size, heap_chunk *prev,
                      size_t status_bits) {
@@ -62,26 +88,63 @@ void free_chunk_init(free_chunk *res, size_t size, heap_chunk *prev,
     };
 }
 
-bool same_heap(allocator *a, void *p1, void *p2) {
-    heap *h1 = get_heap(a, p1);
-    if (h1 == NULL)
-        return false;
-    return h1 == get_heap(a, p2);
+// p2 may be one past the end of p1's heap, nothing is dereferenced
+bool same_heap(void *p1, void *p2) { return heap_of(p1) == heap_of(p2); }
+
+// mmap size bytes at an align aligned address (align a multiple of the page
+// size) by over-mapping and trimming the ends
+void *mmap_aligned(size_t size, size_t align) {
+    size_t to_map = size + align - PAGE_SIZE;
+    char *p = mmap(NULL, to_map, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        return NULL;
+    char *aligned = (char *)(((uint64_t)p + align - 1) & ~(align - 1));
+    if (aligned != p)
+        munmap(p, aligned - p);
+    if (aligned + size != p + to_map)
+        munmap(aligned + size, p + to_map - (aligned + size));
+    return aligned;
+}
+
+// memory for heaps and mmapped chunks, from the allocator's file if it has
+// one
+void *span_map(allocator *a, size_t size, size_t align) {
+    if (a->backing != NULL)
+        return persistent_span(a->backing, size, align);
+    void *p = mmap_aligned(size, align);
+    // before the first touch, so the pages are placed on the node
+    if (p != NULL && a->numa_node >= 0)
+        numa_bind(p, size, a->numa_node);
+    return p;
+}
+
+// only anonymous spans are unmapped, file space is never given back
+void span_unmap(allocator *a, void *p, size_t size) {
+    if (a->backing == NULL)
+        munmap(p, size);
 }
 
 free_chunk *add_heap(allocator *a) {
-    heap *h = mmap(NULL, HEAP_SIZE, PROT_READ | PROT_WRITE,
-                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-    if (h == MAP_FAILED)
+    heap *h = span_map(a, HEAP_SIZE, HEAP_SIZE);
+    if (h == NULL)
+        return NULL;
+    if (!pagemap_set(h, HEAP_SIZE, h, PAGE_HEAP, 0)) {
+        span_unmap(a, h, HEAP_SIZE);
         return NULL;
+    }
+    h->owner = a;
+    h->epoch = a->decay_epoch;
+    h->purged_epoch = UINT64_MAX;
     h->next = a->heaps;
     h->prev = NULL;
     if (a->heaps != NULL)
         a->heaps->prev = h;
     a->heaps = h;
-    a->stats.total_heap_size += HEAP_SIZE;
+    STATS_ADD(a->stats.total_heap_size, HEAP_SIZE);
 
     h->end_of_heap = (uint64_t)h + HEAP_SIZE;
+    h->untouched = (uint64_t)h->free_chunks;
 
     free_chunk *res = (free_chunk *)h->free_chunks;
 
@@ -95,10 +158,9 @@ free_chunk *add_heap(allocator *a) {
     return res;
 }
 
-heap_chunk *next_chunk_no_print(allocator *a, heap_chunk *c) {
+heap_chunk *next_chunk_no_print(heap_chunk *c) {
     heap_chunk *next = (heap_chunk *)(c->data + CHUNK_SIZE(c->status));
-    next = same_heap(a, c, next) ? next : NULL;
-    return next;
+    return same_heap(c, next) ? next : NULL;
 }
 
 void print_free_chunk_for_debug(free_chunk *c) {
@@ -126,7 +188,7 @@ void debug_print_allocator_state(allocator *a) {
         if (!IS_FREE(first->status))
             print_free_chunk_for_debug(first);
         for (free_chunk *c = first; c != NULL;
-             prev = c, c = next_chunk_no_print(a, c)) {
+             prev = c, c = next_chunk_no_print(c)) {
             if (IS_FREE(c->status))
                 print_free_chunk_for_debug(c);
             else {
@@ -140,114 +202,552 @@ void debug_print_allocator_state(allocator *a) {
 #endif
 }
 
+// size classes are computed by the preprocessor for every multiple of
+// ARENA_SIZE_ALIGN up to MAX_ARENA_SIZE, so rounding a size is a table load
+#define NUM_LINEAR_CLASSES                                                     \
+    ((ARENA_DOUBLING_SIZE - MIN_ALLOC_SIZE) / ARENA_SIZE_ALIGN + 1)
+// p with 2^p < s <= 2^(p + 1), for ARENA_DOUBLING_SIZE < s <= MAX_ARENA_SIZE
+#define CLASS_POWER(s) ((s) > 512 ? 9 : (s) > 256 ? 8 : 7)
+#define CLASS_STEP(s) ((1 << CLASS_POWER(s)) / ARENA_CLASSES_PER_DOUBLING)
+#define DOUBLING_CLASS(s)                                                      \
+    (NUM_LINEAR_CLASSES                                                        \
+     + (CLASS_POWER(s) - ARENA_DOUBLING_POWER) * ARENA_CLASSES_PER_DOUBLING    \
+     + ((s) - (1 << CLASS_POWER(s)) - 1) / CLASS_STEP(s))
+#define SIZE_CLASS(s)                                                          \
+    ((s) <= MIN_ALLOC_SIZE        ? 0                                          \
+     : (s) <= ARENA_DOUBLING_SIZE ? ((s)-MIN_ALLOC_SIZE) / ARENA_SIZE_ALIGN    \
+                                  : DOUBLING_CLASS(s))
+#define CLASS_OF(i) SIZE_CLASS((i)*ARENA_SIZE_ALIGN)
+#define CLASSES_8(i)                                                           \
+    CLASS_OF(i), CLASS_OF(i + 1), CLASS_OF(i + 2), CLASS_OF(i + 3),            \
+        CLASS_OF(i + 4), CLASS_OF(i + 5), CLASS_OF(i + 6), CLASS_OF(i + 7)
+#define CLASSES_64(i)                                                          \
+    CLASSES_8(i), CLASSES_8(i + 8), CLASSES_8(i + 16), CLASSES_8(i + 24),      \
+        CLASSES_8(i + 32), CLASSES_8(i + 40), CLASSES_8(i + 48),               \
+        CLASSES_8(i + 56)
+
+// indexed by (size + ARENA_SIZE_ALIGN - 1) / ARENA_SIZE_ALIGN
+static const uint8_t size_classes[] = {CLASSES_64(0), CLASSES_64(64),
+                                       CLASS_OF(128)};
+_Static_assert(sizeof(size_classes) == MAX_ARENA_SIZE / ARENA_SIZE_ALIGN + 1,
+               "size_classes doesn't cover every arena size");
+
+// power of two the doubling bucket b (past the linear ones) is above
+#define BUCKET_BASE(b)                                                         \
+    (ARENA_DOUBLING_SIZE                                                       \
+     << ((b)-NUM_LINEAR_CLASSES) / ARENA_CLASSES_PER_DOUBLING)
+#define BUCKET_SIZE(b)                                                         \
+    ((b) < NUM_LINEAR_CLASSES                                                  \
+         ? MIN_ALLOC_SIZE + (b)*ARENA_SIZE_ALIGN                               \
+         : BUCKET_BASE(b)                                                      \
+               + (((b)-NUM_LINEAR_CLASSES) % ARENA_CLASSES_PER_DOUBLING + 1)   \
+                     * BUCKET_BASE(b) / ARENA_CLASSES_PER_DOUBLING)
+
+static const uint16_t bucket_sizes[NUM_ARENA_BUCKETS] = {
+    BUCKET_SIZE(0),  BUCKET_SIZE(1),  BUCKET_SIZE(2),  BUCKET_SIZE(3),
+    BUCKET_SIZE(4),  BUCKET_SIZE(5),  BUCKET_SIZE(6),  BUCKET_SIZE(7),
+    BUCKET_SIZE(8),  BUCKET_SIZE(9),  BUCKET_SIZE(10), BUCKET_SIZE(11),
+    BUCKET_SIZE(12), BUCKET_SIZE(13), BUCKET_SIZE(14), BUCKET_SIZE(15),
+    BUCKET_SIZE(16), BUCKET_SIZE(17), BUCKET_SIZE(18), BUCKET_SIZE(19),
+    BUCKET_SIZE(20), BUCKET_SIZE(21), BUCKET_SIZE(22), BUCKET_SIZE(23),
+    BUCKET_SIZE(24), BUCKET_SIZE(25), BUCKET_SIZE(26),
+};
+_Static_assert(NUM_ARENA_BUCKETS == 27, "bucket_sizes needs updating");
+
 uint64_t round_to_alloc_size_without_metadata(size_t n) {
+    if (n <= MAX_ARENA_SIZE)
+        return bucket_sizes[get_arena_bucket(n)];
     if (n >= MIN_MMAP)
         return n;
-    if (n < MIN_ALLOC_SIZE)
-        return MIN_ALLOC_SIZE;
-
-    // smallest x such that 16 + 8x >= n
-    // ceil((n - 16) / 8)
-    size_t x = (n - MIN_ALLOC_SIZE + (ARENA_SIZE_ALIGN - 1)) / ARENA_SIZE_ALIGN;
-    size_t p = MIN_ALLOC_SIZE + ARENA_SIZE_ALIGN * x;
-    if (p <= ARENA_DOUBLING_SIZE) {
-        return p;
-    } else if (p <= MAX_ARENA_SIZE) {
-        uint64_t pow_two = ARENA_DOUBLING_SIZE;
-        while (pow_two < p) {
-            pow_two <<= 1;
+    return ROUND_SIZE_TO_ALIGN(n);
+}
+
+// mmapped chunks are at least half a heap, which is the first bin
+uint64_t mmap_cache_bin(size_t size) {
+    return (63 - __builtin_clzll(size)) - __builtin_ctzll(HEAP_SIZE / 2);
+}
+
+// a cached span of at least size bytes from size's bin, with the mmapped
+// chunks locked
+mmapped_chunk *mmap_cache_take(allocator *a, size_t size) {
+    uint64_t bin = mmap_cache_bin(size);
+    // a file's chunks are never unmapped, so bigger ones are taken too
+    uint64_t last = a->backing != NULL ? MMAP_CACHE_BINS - 1 : bin;
+    if (bin >= MMAP_CACHE_BINS)
+        bin = last = MMAP_CACHE_BINS - 1;
+    for (; bin <= last; bin++) {
+        mmapped_chunk **link = &a->mmap_cache[bin];
+        for (; *link != NULL; link = &(*link)->next) {
+            mmapped_chunk *c = *link;
+            if (CHUNK_SIZE(c->status) >= size) {
+                *link = c->next;
+                STATS_SUB(a->stats.mmap_cache_bytes, CHUNK_SIZE(c->status));
+                return c;
+            }
         }
-        return pow_two;
     }
+    return NULL;
+}
 
-    return ROUND_SIZE_TO_ALIGN(n);
+// keep c mapped for reuse if the budget allows, with the mmapped chunks
+// locked
+bool mmap_cache_put(allocator *a, mmapped_chunk *c) {
+    size_t size = CHUNK_SIZE(c->status);
+    uint64_t bin = mmap_cache_bin(size);
+    if (a->backing != NULL) {
+        if (bin >= MMAP_CACHE_BINS)
+            bin = MMAP_CACHE_BINS - 1;
+    } else if (bin >= MMAP_CACHE_BINS
+               || a->stats.mmap_cache_bytes + size > MMAP_CACHE_BUDGET) {
+        return false;
+    }
+    c->next = a->mmap_cache[bin];
+    a->mmap_cache[bin] = c;
+    STATS_ADD(a->stats.mmap_cache_bytes, size);
+    return true;
 }
 
-void *allo_cate_mmaped(allocator *a, size_t size) {
-    debug_printf("allo_cate_mmaped: %lu\n", size);
-    size_t to_alloc = size + sizeof(struct mmapped_chunk);
-    mmapped_chunk *c = mmap(NULL, to_alloc, PROT_READ | PROT_WRITE,
-                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-    // need accurate allocation size because munmap requires size
-    c->status = to_alloc | MMAPPED;
+// with the mmapped chunks locked
+void mmapped_link(allocator *a, mmapped_chunk *c) {
     c->prev = NULL;
     c->next = a->mmapped_chunk_head;
     if (a->mmapped_chunk_head != NULL) {
         a->mmapped_chunk_head->prev = c;
     }
-    a->stats.num_bytes_allocated += to_alloc;
+    a->mmapped_chunk_head = c;
+}
+
+void mmapped_unlink(allocator *a, mmapped_chunk *c) {
+    if (c->prev) {
+        c->prev->next = c->next;
+    } else {
+        a->mmapped_chunk_head = c->next;
+    }
+
+    if (c->next)
+        c->next->prev = c->prev;
+}
+
+// bytes of a new allocation known to still be zero
+typedef struct zero_span {
+    uint64_t start;
+    uint64_t end;
+} zero_span;
+
+void *allo_cate_mmaped(allocator *a, size_t size, zero_span *zero) {
+    debug_printf("allo_cate_mmaped: %lu\n", size);
+    // no mapping is this big, and rounding it up below would wrap
+    if (size > SIZE_MAX / 2)
+        return NULL;
+    // whole pages, so the size survives CHUNK_SIZE
+    size_t to_alloc =
+        (size + sizeof(struct mmapped_chunk) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    LOCK(a->mmap_lock);
+    mmapped_chunk *c = mmap_cache_take(a, to_alloc);
+    UNLOCK(a->mmap_lock);
+    if (c != NULL) {
+        STATS_ADD(a->stats.mmap_cache_hits, 1);
+        to_alloc = CHUNK_SIZE(c->status);
+    } else {
+        STATS_ADD(a->stats.mmap_cache_misses, 1);
+        c = span_map(a, to_alloc, PAGE_SIZE);
+        if (c == NULL)
+            return NULL;
+        if (zero != NULL)
+            *zero = (zero_span){(uint64_t)c->data, (uint64_t)c + to_alloc};
+    }
+    if (!pagemap_set(c, to_alloc, c, PAGE_MMAPPED, 0)) {
+        span_unmap(a, c, to_alloc);
+        return NULL;
+    }
+    // need accurate allocation size because munmap requires size
+    c->status = to_alloc | MMAPPED;
+    c->owner = a;
+    LOCK(a->mmap_lock);
+    mmapped_link(a, c);
+    UNLOCK(a->mmap_lock);
+    STATS_ADD(a->stats.num_bytes_allocated, to_alloc);
     return c->data;
 }
 
-uint64_t get_arena_bucket(uint64_t status) {
-    uint64_t size = ARENA_CHUNK_SIZE(status);
-    if (size <= ARENA_DOUBLING_SIZE)
-        return (size - MIN_ALLOC_SIZE) / ARENA_SIZE_ALIGN;
+// a fresh mapping with the data at the first align aligned address past the
+// header
+void *allo_cate_mmaped_aligned(allocator *a, size_t align, size_t size) {
+    debug_printf("allo_cate_mmaped_aligned: %lu %lu\n", align, size);
+    size_t to_alloc = (size + sizeof(struct mmapped_chunk) + align + PAGE_SIZE - 1)
+                      & ~(PAGE_SIZE - 1);
+    mmapped_chunk *c =
+        span_map(a, to_alloc, align > PAGE_SIZE ? align : PAGE_SIZE);
+    if (c == NULL)
+        return NULL;
+    if (!pagemap_set(c, to_alloc, c, PAGE_MMAPPED, 0)) {
+        span_unmap(a, c, to_alloc);
+        return NULL;
+    }
+    c->status = to_alloc | MMAPPED;
+    c->owner = a;
+    LOCK(a->mmap_lock);
+    mmapped_link(a, c);
+    UNLOCK(a->mmap_lock);
+    STATS_ADD(a->stats.num_bytes_allocated, to_alloc);
+    return (void *)(((uint64_t)c->data + align - 1) & ~(align - 1));
+}
+
+// any size <= MAX_ARENA_SIZE
+uint64_t get_arena_bucket(uint64_t size) {
+    return size_classes[(size + ARENA_SIZE_ALIGN - 1) / ARENA_SIZE_ALIGN];
+}
+
+uint64_t arena_bucket_size(uint64_t bucket) { return bucket_sizes[bucket]; }
+
+// the first slab of a slab heap starts after the heap header
+slab *slab_of(void *p) {
+    uint64_t start = (uint64_t)p & ~(SLAB_SIZE - 1);
+    if ((start & (HEAP_SIZE - 1)) == 0)
+        start += sizeof(heap);
+    return (slab *)start;
+}
+
+// room for the header and bitmap of s in front of num_slots objects aligned
+// to align
+size_t slab_header_size(slab *s, size_t num_slots, size_t align) {
+    uint64_t objects = (uint64_t)s + sizeof(slab)
+                       + (num_slots + 63) / 64 * sizeof(uint64_t);
+    return ((objects + align - 1) & ~(align - 1)) - (uint64_t)s;
+}
+
+// map a heap and split it into free slabs, with the heaps locked
+bool add_slab_heap(allocator *a) {
+    heap *h = span_map(a, HEAP_SIZE, HEAP_SIZE);
+    if (h == NULL)
+        return false;
+    h->owner = a;
+    h->allocated_bytes = 0;
+    h->epoch = a->decay_epoch;
+    h->next = a->slab_heaps;
+    h->prev = NULL;
+    if (a->slab_heaps != NULL)
+        a->slab_heaps->prev = h;
+    a->slab_heaps = h;
+    h->end_of_heap = (uint64_t)h + HEAP_SIZE;
+    STATS_ADD(a->stats.total_heap_size, HEAP_SIZE);
+
+    for (size_t i = HEAP_SIZE / SLAB_SIZE; i > 0; i--) {
+        slab *s = slab_of((char *)h + (i - 1) * SLAB_SIZE);
+        s->kind = PAGE_NONE;
+        s->zero_from = 0;
+        s->next = a->free_slabs;
+        a->free_slabs = s;
+    }
+    debug_printf("add_slab_heap: %p\n", h);
+    return true;
+}
+
+// a free slab of objects of size bytes aligned to align, recorded in the page
+// map as kind. NULL if out of memory
+slab *slab_new(allocator *a, uint32_t size, uint32_t align,
+               enum page_kind kind, uint32_t size_class) {
+    LOCK(a->heap_lock);
+    if (a->free_slabs == NULL && !add_slab_heap(a)) {
+        UNLOCK(a->heap_lock);
+        return NULL;
+    }
+    slab *s = a->free_slabs;
+    void *start = (void *)((uint64_t)s & ~(SLAB_SIZE - 1));
+    if (!pagemap_set(start, SLAB_SIZE, start, kind, size_class)) {
+        UNLOCK(a->heap_lock);
+        return NULL;
+    }
+    a->free_slabs = s->next;
+    heap_of(s)->allocated_bytes += SLAB_SIZE;
+    heap_of(s)->epoch = a->decay_epoch;
+    UNLOCK(a->heap_lock);
+    STATS_ADD(a->stats.num_bytes_allocated, SLAB_SIZE);
+
+    if (align < MIN_ALLOC_SIZE)
+        align = MIN_ALLOC_SIZE;
+    uint32_t room = (char *)start + SLAB_SIZE - (char *)s;
+    uint32_t num_slots = (room - sizeof(slab)) / size;
+    while (slab_header_size(s, num_slots, align) + num_slots * size > room)
+        num_slots--;
+    s->size = size;
+    s->num_slots = num_slots;
+    s->num_free = num_slots;
+    s->objects = slab_header_size(s, num_slots, align);
+    s->kind = kind;
+    // the header is written over whatever was there
+    if (s->zero_from < s->objects)
+        s->zero_from = s->objects;
+    for (uint32_t i = 0; i < num_slots / 64; i++)
+        s->bitmap[i] = ~0ull;
+    if (num_slots % 64 != 0)
+        s->bitmap[num_slots / 64] = (1ull << (num_slots % 64)) - 1;
+    return s;
+}
+
+slab *cache_slab_new(allocator *a, uint32_t size, uint32_t align) {
+    return slab_new(a, size, align, PAGE_CACHE, 0);
+}
+
+// a fresh slab of bucket's size pushed onto the arena, with the arena locked.
+// objects are aligned to the largest power of two dividing their size
+bool arena_grow(allocator *a, arena *arena, uint64_t bucket) {
+    uint32_t size = arena_bucket_size(bucket);
+    slab *s = slab_new(a, size, size & -size, PAGE_SLAB, bucket);
+    if (s == NULL)
+        return false;
+
+    s->prev = NULL;
+    s->next = arena->partial_slabs;
+    if (arena->partial_slabs != NULL)
+        arena->partial_slabs->prev = s;
+    arena->partial_slabs = s;
+    arena->num_empty_slabs++;
+    return true;
+}
+
+void slab_unlink(arena *arena, slab *s) {
+    if (s->prev != NULL)
+        s->prev->next = s->next;
+    else
+        arena->partial_slabs = s->next;
+    if (s->next != NULL)
+        s->next->prev = s->prev;
+}
 
-    int64_t pow_two = sizeof(uint64_t) * 8 - __builtin_clzll(size - 1);
-    return pow_two - ARENA_DOUBLING_POWER
-           + (ARENA_DOUBLING_SIZE - MIN_ALLOC_SIZE) / ARENA_SIZE_ALIGN;
+// slot is being handed out, so it no longer counts as zero
+void slab_touch(slab *s, uint32_t slot) {
+    uint32_t end = s->objects + (slot + 1) * s->size;
+    if (end > s->zero_from)
+        s->zero_from = end;
 }
 
-size_t arena_block_size(size_t size) {
-    size_t arena_size = size * ARENA_GROWTH_FACTOR + sizeof(arena_block);
-    if (arena_size <= MAX_ARENA_SIZE) {
-        arena_size = ROUND_SIZE_TO_ALIGN(MAX_ARENA_SIZE + sizeof(arena_block));
+// append up to n free objects of s to *link, returns how many
+size_t slab_take(slab *s, size_t n, arena_free_chunk ***link) {
+    char *objects = (char *)s + s->objects;
+    size_t taken = 0;
+    for (uint32_t i = 0; taken < n && i < (s->num_slots + 63) / 64; i++) {
+        uint64_t word = s->bitmap[i];
+        while (word != 0 && taken < n) {
+            uint32_t slot = i * 64 + __builtin_ctzll(word);
+            word &= word - 1;
+            slab_touch(s, slot);
+            arena_free_chunk *c = (arena_free_chunk *)(objects + slot * s->size);
+            **link = c;
+            *link = &c->next;
+            taken++;
+        }
+        s->bitmap[i] = word;
     }
-    return arena_size;
+    s->num_free -= taken;
+    return taken;
 }
 
-void *allo_cate_arena(allocator *a, size_t to_alloc) {
-    void *res;
+// the lowest free slot of s, which must have one
+void *slab_take_one(slab *s) {
+    uint32_t i = 0;
+    while (s->bitmap[i] == 0)
+        i++;
+    uint32_t slot = i * 64 + __builtin_ctzll(s->bitmap[i]);
+    s->bitmap[i] &= s->bitmap[i] - 1;
+    s->num_free--;
+    slab_touch(s, slot);
+    return (char *)s + s->objects + slot * s->size;
+}
 
-    // changes other thing in tree between
+// the same as slab_take, only from the slots past zero_from. those were
+// never handed out, so they are all free
+size_t slab_take_zeroed(slab *s, size_t n, arena_free_chunk ***link) {
+    uint32_t slot = 0;
+    if (s->zero_from > s->objects)
+        slot = (s->zero_from - s->objects + s->size - 1) / s->size;
+    size_t taken = 0;
+    for (; taken < n && slot < s->num_slots; slot++, taken++) {
+        debug_assert(s->bitmap[slot / 64] & (1ull << (slot % 64)));
+        s->bitmap[slot / 64] &= ~(1ull << (slot % 64));
+        slab_touch(s, slot);
+        arena_free_chunk *c =
+            (arena_free_chunk *)((char *)s + s->objects + slot * s->size);
+        **link = c;
+        *link = &c->next;
+    }
+    s->num_free -= taken;
+    return taken;
+}
+
+void slab_return(slab *s, void *p) {
+    uint32_t slot = ((char *)p - ((char *)s + s->objects)) / s->size;
+    debug_assert(!(s->bitmap[slot / 64] & (1ull << (slot % 64))));
+    s->bitmap[slot / 64] |= 1ull << (slot % 64);
+    s->num_free++;
+}
+
+// hand an empty slab back so any size class can use it, with its arena
+// locked and s already unlinked
+void slab_release(allocator *a, slab *s) {
+    void *start = (void *)((uint64_t)s & ~(SLAB_SIZE - 1));
+    pagemap_clear(start, SLAB_SIZE);
+    s->kind = PAGE_NONE;
+    LOCK(a->heap_lock);
+    s->next = a->free_slabs;
+    a->free_slabs = s;
+    heap_of(s)->allocated_bytes -= SLAB_SIZE;
+    heap_of(s)->epoch = a->decay_epoch;
+    UNLOCK(a->heap_lock);
+    STATS_SUB(a->stats.num_bytes_allocated, SLAB_SIZE);
+}
+
+// give p back to its slab, with the arena locked. past ARENA_WARM_SLABS
+// empty slabs are released, returns whether s was
+bool slab_put(allocator *a, arena *arena, void *p) {
+    slab *s = slab_of(p);
+    slab_return(s, p);
+    if (s->num_free == 1) {
+        s->prev = NULL;
+        s->next = arena->partial_slabs;
+        if (arena->partial_slabs != NULL)
+            arena->partial_slabs->prev = s;
+        arena->partial_slabs = s;
+    }
+    if (s->num_free < s->num_slots)
+        return false;
+    if (arena->num_empty_slabs < ARENA_WARM_SLABS) {
+        arena->num_empty_slabs++;
+        return false;
+    }
+    slab_unlink(arena, s);
+    slab_release(a, s);
+    return true;
+}
+
+bool transfer_cache_insert(allocator *a, uint64_t bucket,
+                           arena_free_chunk *head) {
+    transfer_cache *tc = &a->transfer_caches[bucket];
+    LOCK(tc->lock);
+    bool inserted = tc->num_batches < TRANSFER_SLOTS;
+    if (inserted)
+        tc->batches[tc->num_batches++] = head;
+    UNLOCK(tc->lock);
+    return inserted;
+}
+
+arena_free_chunk *transfer_cache_remove(allocator *a, uint64_t bucket) {
+    transfer_cache *tc = &a->transfer_caches[bucket];
+    // racy peek, an empty cache is common and not worth a lock
+    if (__atomic_load_n(&tc->num_batches, __ATOMIC_RELAXED) == 0)
+        return NULL;
+    arena_free_chunk *head = NULL;
+    LOCK(tc->lock);
+    if (tc->num_batches > 0)
+        head = tc->batches[--tc->num_batches];
+    UNLOCK(tc->lock);
+    return head;
+}
+
+// take up to n free objects of size to_alloc out of the slabs, growing the
+// arena if it is empty. returns the number of objects linked from *head
+size_t allo_cate_arena_list(allocator *a, size_t to_alloc, size_t n,
+                            arena_free_chunk **head) {
+    uint64_t bucket = get_arena_bucket(to_alloc);
+    if (n >= TRANSFER_BATCH) {
+        *head = transfer_cache_remove(a, bucket);
+        if (*head != NULL)
+            return TRANSFER_BATCH;
+    }
+
+    arena *arena = &a->arenas[bucket];
+    arena_free_chunk **link = head;
+    size_t taken = 0;
+    LOCK(arena->lock);
+    if (arena->partial_slabs == NULL && !arena_grow(a, arena, bucket)) {
+        UNLOCK(arena->lock);
+        *head = NULL;
+        return 0;
+    }
+    while (taken < n && arena->partial_slabs != NULL) {
+        slab *s = arena->partial_slabs;
+        if (s->num_free == s->num_slots)
+            arena->num_empty_slabs--;
+        taken += slab_take(s, n - taken, &link);
+        if (s->num_free == 0)
+            slab_unlink(arena, s);
+    }
+    UNLOCK(arena->lock);
+    *link = NULL;
+    return taken;
+}
+
+// fresh slabs are only grown for an arena with nothing free, otherwise used
+// memory is better handed out (and cleared) than more mapped. grown and
+// partly freed slabs go to the front, so the first without zero slots ends
+// the search
+size_t allo_cate_arena_zeroed_list(allocator *a, size_t to_alloc, size_t n,
+                                   arena_free_chunk **head) {
     uint64_t bucket = get_arena_bucket(to_alloc);
     arena *arena = &a->arenas[bucket];
-    debug_printf("allo_cate_arena: %lu %lu\n", to_alloc, bucket);
-
-try_take_from_free_list:
-    if (arena->free_list) {
-        arena_free_chunk *c = arena->free_list;
-        arena->free_list = c->next;
-        chunk *ch = (chunk *)c;
-        ch->status = to_alloc;
-        res = ch->data;
-        goto end;
-    }
-
-    size_t arena_size = arena_block_size(to_alloc);
-    arena_block *block = allo_cate(a, arena_size);
-    block->prev = NULL;
-    block->next = arena->arena_block_head;
-    if (arena->arena_block_head != NULL)
-        arena->arena_block_head->prev = block;
-    arena->arena_block_head = block;
-    if (block == NULL) {
-        res = NULL;
-        goto end;
-    }
-
-    uint64_t end_of_block = (uint64_t)block + arena_size;
-    arena_free_chunk *c = (arena_free_chunk *)block->data;
-    while ((uint64_t)c + sizeof(chunk) + to_alloc < end_of_block) {
-        c->status = to_alloc | FREE;
-        c->next = arena->free_list;
-        arena->free_list = c;
-
-        c = (arena_free_chunk *)(((chunk *)c)->data + to_alloc);
-    }
-
-    goto try_take_from_free_list;
-end:
-    avl_tree_debug_print(a->free_chunk_tree);
+    arena_free_chunk **link = head;
+    size_t taken = 0;
+    LOCK(arena->lock);
+    if (arena->partial_slabs == NULL && !arena_grow(a, arena, bucket)) {
+        UNLOCK(arena->lock);
+        *head = NULL;
+        return 0;
+    }
+    slab *next;
+    for (slab *s = arena->partial_slabs; taken < n && s != NULL; s = next) {
+        next = s->next;
+        bool empty = s->num_free == s->num_slots;
+        size_t got = slab_take_zeroed(s, n - taken, &link);
+        if (got == 0)
+            break;
+        if (empty)
+            arena->num_empty_slabs--;
+        if (s->num_free == 0)
+            slab_unlink(arena, s);
+        taken += got;
+    }
+    UNLOCK(arena->lock);
+    *link = NULL;
+    return taken;
+}
+
+// give a list of n free objects (ending at tail) of one bucket back
+void allo_free_arena_list(allocator *a, uint64_t bucket, arena_free_chunk *head,
+                          arena_free_chunk *tail, size_t n) {
+    tail->next = NULL;
+    if (n == TRANSFER_BATCH && transfer_cache_insert(a, bucket, head))
+        return;
+
+    arena *arena = &a->arenas[bucket];
+    bool released = false;
+    LOCK(arena->lock);
+    while (head != NULL) {
+        arena_free_chunk *next = head->next;
+        released |= slab_put(a, arena, head);
+        head = next;
+    }
+    UNLOCK(arena->lock);
+    if (released)
+        allo_decay(a);
+}
+
+void *allo_cate_arena(allocator *a, size_t to_alloc) {
+    debug_printf("allo_cate_arena: %lu %lu\n", to_alloc,
+                 get_arena_bucket(to_alloc));
+
+    arena_free_chunk *c;
+    if (allo_cate_arena_list(a, to_alloc, 1, &c) == 0)
+        return NULL;
+
+    free_index_debug_print(a);
     debug_printf("END allo_cate_arena: %lu %lu\n", to_alloc,
                  get_arena_bucket(to_alloc));
-    return res;
+    return c;
 }
 
-heap_chunk *next_chunk(allocator *a, heap_chunk *c) {
+heap_chunk *next_chunk(heap_chunk *c) {
     heap_chunk *next = (heap_chunk *)(c->data + CHUNK_SIZE(c->status));
-    next = same_heap(a, c, next) ? next : NULL;
+    next = same_heap(c, next) ? next : NULL;
     debug_printf("next of %p is %p\n", c, next);
     return next;
 }
@@ -259,16 +759,14 @@ heap_chunk *prev_chunk(heap_chunk *c) {
 
 // chunk is not yet in the tree
 void coalesce(allocator *a, heap_chunk *chunk) {
-#ifdef ALLO_AVL_DEBUG
-    debug_assert(!avl_tree_contains(a->free_chunk_tree, chunk));
-#endif
+    debug_assert(!free_index_contains(a, chunk));
 
     uint64_t size = CHUNK_SIZE(chunk->status);
     debug_printf("coalesce: %p (size %lu)\n", chunk, size);
 
     heap_chunk *prev = prev_chunk(chunk);
     if (prev && IS_FREE(prev->status)) {
-        a->free_chunk_tree = avl_tree_remove_node(a->free_chunk_tree, prev);
+        free_index_remove(a, prev);
         size += CHUNK_SIZE(prev->status) + sizeof(heap_chunk);
         chunk = prev;
         chunk->status = size;
@@ -276,13 +774,12 @@ void coalesce(allocator *a, heap_chunk *chunk) {
 
     debug_assert(size == CHUNK_SIZE(size));
 
-    heap_chunk *next_absolute = next_chunk(a, chunk);
+    heap_chunk *next_absolute = next_chunk(chunk);
     if (next_absolute && IS_FREE(next_absolute->status)) {
-        heap_chunk *next_again = next_chunk(a, next_absolute);
+        heap_chunk *next_again = next_chunk(next_absolute);
         if (next_again)
             next_again->prev = chunk;
-        a->free_chunk_tree =
-            avl_tree_remove_node(a->free_chunk_tree, next_absolute);
+        free_index_remove(a, next_absolute);
         size += CHUNK_SIZE(next_absolute->status) + sizeof(heap_chunk);
     } else if (next_absolute) {
         next_absolute->prev = chunk;
@@ -290,197 +787,1049 @@ void coalesce(allocator *a, heap_chunk *chunk) {
 
     debug_assert(size == CHUNK_SIZE(size));
 
-    free_chunk_init(chunk, size, chunk->prev, FREE | TREE);
+    free_chunk_init(chunk, size, chunk->prev, FREE);
 
-    a->free_chunk_tree =
-        avl_tree_insert(a->free_chunk_tree, (free_chunk_tree *)chunk);
-    avl_tree_debug_print(a->free_chunk_tree);
+    free_index_insert(a, chunk);
+    free_index_debug_print(a);
 
     debug_printf("END coalesce: %p (size %lu)\n", chunk,
                  CHUNK_SIZE(chunk->status));
 }
 
-void *allo_cate_standard(allocator *a, size_t to_alloc) {
+// give the end of c beyond to_alloc back as a free chunk if it is worth it,
+// with the heaps locked
+void split_chunk(allocator *a, heap_chunk *c, size_t to_alloc) {
+    size_t leftover = SIZE(c) - to_alloc;
+    if (leftover <= sizeof(heap_chunk) + MAX_ARENA_SIZE)
+        return;
+
+    size_t new_size = CHUNK_SIZE(c->status) - leftover;
+    debug_assert(new_size == CHUNK_SIZE(new_size));
+
+    leftover -= sizeof(heap_chunk);
+    // alignment
+    debug_assert(leftover == CHUNK_SIZE(leftover));
+
+    debug_printf("Split node of size %lu into %lu and %lu\n",
+                 CHUNK_SIZE(c->status), new_size, leftover);
+
+    c->status = new_size;
+    free_chunk *split_chunk = (free_chunk *)(c->data + new_size);
+    free_chunk_init(split_chunk, leftover, c, FREE);
+
+    coalesce(a, split_chunk);
+}
+
+// the whole pages of a free chunk past its free chunk links
+void purgeable_range(heap_chunk *c, uint64_t *start, uint64_t *end) {
+    *start = ((uint64_t)c + sizeof(free_chunk_tree) + PAGE_SIZE - 1)
+             & ~(PAGE_SIZE - 1);
+    *end = ((uint64_t)c->data + SIZE(c)) & ~(PAGE_SIZE - 1);
+    if (*end < *start)
+        *end = *start;
+}
+
+// the part of free chunk c that is still zero, if any
+zero_span chunk_zero_span(heap_chunk *c) {
+    heap *h = heap_of(c);
+    uint64_t links = (uint64_t)c + sizeof(free_chunk_tree);
+    if ((uint64_t)c >= h->untouched)
+        return (zero_span){links, (uint64_t)c->data + SIZE(c)};
+    zero_span res = {0, 0};
+    if (c->status & PURGED)
+        purgeable_range(c, &res.start, &res.end);
+    return res;
+}
+
+void *allo_cate_standard(allocator *a, size_t to_alloc, zero_span *zero) {
     debug_printf("allo_cate: standard %lu\n", to_alloc);
-    free_chunk *best_fit = avl_tree_search(a->free_chunk_tree, to_alloc);
+    LOCK(a->heap_lock);
+    free_chunk *best_fit = free_index_search(a, to_alloc);
 
     if (best_fit == NULL) {
         best_fit = add_heap(a);
-        if (best_fit == NULL)
+        if (best_fit == NULL) {
+            UNLOCK(a->heap_lock);
             return NULL;
+        }
     } else {
-        a->free_chunk_tree = avl_tree_remove_node(a->free_chunk_tree, best_fit);
+        free_index_remove(a, best_fit);
     }
 
-    best_fit->status &= ~(FREE | TREE);
+    if (zero != NULL)
+        *zero = chunk_zero_span(best_fit);
+    best_fit->status &= ~(FREE | TREE | PURGED);
+    heap_of(best_fit)->epoch = a->decay_epoch;
+
+    split_chunk(a, best_fit, to_alloc);
+    uint64_t end = (uint64_t)best_fit->data + SIZE(best_fit);
+    if (heap_of(best_fit)->untouched < end)
+        heap_of(best_fit)->untouched = end;
+
+    UNLOCK(a->heap_lock);
 
-    // try split node
-    size_t leftover = SIZE(best_fit) - to_alloc;
-    if (leftover > sizeof(heap_chunk) + MAX_ARENA_SIZE) {
-        size_t new_size = CHUNK_SIZE(best_fit->status) - leftover;
-        debug_assert(new_size == CHUNK_SIZE(new_size));
+    STATS_ADD(a->stats.num_bytes_allocated, CHUNK_SIZE(best_fit->status));
 
-        leftover -= sizeof(heap_chunk);
-        // alignment
-        debug_assert(leftover == CHUNK_SIZE(leftover));
+    return best_fit->data;
+}
 
-        debug_printf("Split node of size %lu into %lu and %lu\n",
-                     CHUNK_SIZE(best_fit->status), new_size, leftover);
+// smallest front gap worth splitting off as a free chunk of its own
+#define MIN_ALIGN_GAP (sizeof(heap_chunk) + MAX_ARENA_SIZE + CHUNK_SIZE_ALIGN)
 
-        size_t flags = best_fit->status & (MMAPPED | FREE | TREE);
-        best_fit->status = new_size | flags;
-        free_chunk *split_chunk = (free_chunk *)(best_fit->data + new_size);
-        free_chunk_init(split_chunk, leftover, best_fit, FREE);
+// a chunk whose data is align aligned. the gap in front of the aligned
+// address goes back as a free chunk, the tail as with allo_cate_standard
+void *allo_cate_standard_aligned(allocator *a, size_t align, size_t to_alloc) {
+    debug_printf("allo_cate: standard aligned %lu %lu\n", align, to_alloc);
+    LOCK(a->heap_lock);
+    free_chunk *best_fit =
+        free_index_search(a, to_alloc + align + MIN_ALIGN_GAP);
 
-        coalesce(a, split_chunk);
+    if (best_fit == NULL) {
+        best_fit = add_heap(a);
+        if (best_fit == NULL) {
+            UNLOCK(a->heap_lock);
+            return NULL;
+        }
+    } else {
+        free_index_remove(a, best_fit);
+    }
 
-        best_fit->status = new_size;
+    heap_chunk *c = best_fit;
+    uint64_t data = (uint64_t)best_fit->data;
+    if ((data & (align - 1)) != 0) {
+        uint64_t aligned = (data + MIN_ALIGN_GAP + align - 1) & ~(align - 1);
+        c = to_heap_chunk((void *)aligned);
+        size_t gap = (uint64_t)c - data;
+        c->prev = best_fit;
+        c->status = SIZE(best_fit) - gap - sizeof(heap_chunk);
+        heap_chunk *next = next_chunk(c);
+        if (next)
+            next->prev = c;
+        free_chunk_init(best_fit, gap, best_fit->prev, FREE);
+        coalesce(a, best_fit);
     }
 
-    a->stats.num_bytes_allocated += CHUNK_SIZE(best_fit->status);
+    c->status &= ~(FREE | TREE | PURGED);
+    heap_of(c)->epoch = a->decay_epoch;
 
-    return best_fit->data;
+    split_chunk(a, c, to_alloc);
+    uint64_t end = (uint64_t)c->data + SIZE(c);
+    if (heap_of(c)->untouched < end)
+        heap_of(c)->untouched = end;
+
+    UNLOCK(a->heap_lock);
+
+    STATS_ADD(a->stats.num_bytes_allocated, SIZE(c));
+
+    return c->data;
 }
 
-void *allo_cate(allocator *a, size_t size) {
+// unmap cached mmapped chunks that don't fit in *keep bytes, with the
+// mmapped chunks locked
+size_t mmap_cache_purge(allocator *a, size_t *keep) {
+    size_t purged = 0;
+    for (size_t i = 0; i < MMAP_CACHE_BINS; i++) {
+        mmapped_chunk **link = &a->mmap_cache[i];
+        while (*link != NULL) {
+            mmapped_chunk *c = *link;
+            size_t size = CHUNK_SIZE(c->status);
+            if (size <= *keep) {
+                *keep -= size;
+                link = &c->next;
+                continue;
+            }
+            *link = c->next;
+            STATS_SUB(a->stats.mmap_cache_bytes, size);
+            munmap(c, size);
+            purged += size;
+        }
+    }
+    return purged;
+}
+
+bool heap_is_free(heap *h) {
+    heap_chunk *first = (heap_chunk *)h->free_chunks;
+    return IS_FREE(first->status)
+           && SIZE(first) == HEAP_SIZE - sizeof(heap) - sizeof(heap_chunk);
+}
+
+// unmap a heap that is one free chunk, with the heaps locked
+void remove_heap(allocator *a, heap *h) {
+    free_index_remove(a, (free_chunk *)h->free_chunks);
+    if (h->prev != NULL)
+        h->prev->next = h->next;
+    else
+        a->heaps = h->next;
+    if (h->next != NULL)
+        h->next->prev = h->prev;
+    pagemap_clear(h, HEAP_SIZE);
+    munmap(h, HEAP_SIZE);
+    STATS_SUB(a->stats.total_heap_size, HEAP_SIZE);
+}
+
+// the same for slab heaps with no slab in use and the pages of free slabs
+// past their first, with the heaps locked
+size_t purge_slab_heaps(allocator *a, size_t *keep, uint64_t idle_before) {
+    size_t purged = 0;
+    heap *unused = NULL;
+    heap *next;
+    for (heap *h = a->slab_heaps; h != NULL; h = next) {
+        next = h->next;
+        if (h->epoch >= idle_before || h->allocated_bytes != 0)
+            continue;
+        if (HEAP_SIZE <= *keep) {
+            *keep -= HEAP_SIZE;
+            continue;
+        }
+        if (h->prev != NULL)
+            h->prev->next = h->next;
+        else
+            a->slab_heaps = h->next;
+        if (h->next != NULL)
+            h->next->prev = h->prev;
+        // marks its slabs for removal from the free list
+        h->owner = NULL;
+        h->next = unused;
+        unused = h;
+    }
+
+    slab **link = &a->free_slabs;
+    while (*link != NULL) {
+        slab *s = *link;
+        heap *h = heap_of(s);
+        if (h->owner == NULL) {
+            *link = s->next;
+            continue;
+        }
+        link = &s->next;
+        if (s->size == 0 || h->epoch >= idle_before)
+            continue;
+        char *start = (char *)((uint64_t)s & ~(SLAB_SIZE - 1));
+        if (SLAB_SIZE - PAGE_SIZE <= *keep) {
+            *keep -= SLAB_SIZE - PAGE_SIZE;
+            continue;
+        }
+        madvise(start + PAGE_SIZE, SLAB_SIZE - PAGE_SIZE, MADV_DONTNEED);
+        s->size = 0;
+        uint32_t zero_from = start + PAGE_SIZE - (char *)s;
+        if (zero_from < s->zero_from)
+            s->zero_from = zero_from;
+        purged += SLAB_SIZE - PAGE_SIZE;
+    }
+
+    for (heap *h = unused; h != NULL; h = next) {
+        next = h->next;
+        munmap(h, HEAP_SIZE);
+        STATS_SUB(a->stats.total_heap_size, HEAP_SIZE);
+        purged += HEAP_SIZE;
+    }
+    return purged;
+}
+
+// unmap free heaps and madvise away free runs inside heaps that don't fit in
+// *keep bytes, only looking at heaps last used before epoch idle_before that
+// haven't been purged since. with the heaps locked
+size_t purge_heaps(allocator *a, size_t *keep, uint64_t idle_before) {
+    size_t purged = 0;
+    heap *next;
+    for (heap *h = a->heaps; h != NULL; h = next) {
+        next = h->next;
+        if (h->epoch >= idle_before || !heap_is_free(h))
+            continue;
+        if (HEAP_SIZE <= *keep) {
+            *keep -= HEAP_SIZE;
+            continue;
+        }
+        remove_heap(a, h);
+        purged += HEAP_SIZE;
+    }
+
+    for (heap *h = a->heaps; h != NULL; h = h->next) {
+        if (h->epoch >= idle_before || h->purged_epoch == h->epoch)
+            continue;
+        bool all_purged = true;
+        for (heap_chunk *c = (heap_chunk *)h->free_chunks; c != NULL;
+             c = next_chunk_no_print(c)) {
+            if (!IS_FREE(c->status) || (c->status & PURGED))
+                continue;
+            uint64_t start, end;
+            purgeable_range(c, &start, &end);
+            if (end - start <= *keep) {
+                *keep -= end - start;
+                all_purged &= end == start;
+                continue;
+            }
+            c->status |= PURGED;
+            if (end > start)
+                madvise((void *)start, end - start, MADV_DONTNEED);
+            purged += end - start;
+        }
+        // any later use of h moves its epoch past the current one
+        if (all_purged && h->epoch < a->decay_epoch)
+            h->purged_epoch = h->epoch;
+    }
+    return purged + purge_slab_heaps(a, keep, idle_before);
+}
+
+// put the transfer cache's batches back in their slabs and release every
+// empty slab of the bucket, warm ones included
+void arena_flush(allocator *a, uint64_t bucket) {
+    transfer_cache *tc = &a->transfer_caches[bucket];
+    arena_free_chunk *batches[TRANSFER_SLOTS];
+    LOCK(tc->lock);
+    uint64_t num_batches = tc->num_batches;
+    memcpy(batches, tc->batches, num_batches * sizeof(batches[0]));
+    tc->num_batches = 0;
+    UNLOCK(tc->lock);
+
+    arena *arena = &a->arenas[bucket];
+    LOCK(arena->lock);
+    for (uint64_t i = 0; i < num_batches; i++) {
+        for (arena_free_chunk *c = batches[i], *next; c != NULL; c = next) {
+            next = c->next;
+            slab_put(a, arena, c);
+        }
+    }
+    slab *next;
+    for (slab *s = arena->partial_slabs; s != NULL; s = next) {
+        next = s->next;
+        if (s->num_free < s->num_slots)
+            continue;
+        slab_unlink(arena, s);
+        slab_release(a, s);
+    }
+    arena->num_empty_slabs = 0;
+    UNLOCK(arena->lock);
+}
+
+size_t allo_trim(allocator *a, size_t keep_bytes) {
+    // a file's memory is never given back
+    if (a->backing != NULL)
+        return 0;
+    for (uint64_t bucket = 0; bucket < NUM_ARENA_BUCKETS; bucket++)
+        arena_flush(a, bucket);
+    size_t keep = keep_bytes;
+    LOCK(a->mmap_lock);
+    size_t purged = mmap_cache_purge(a, &keep);
+    UNLOCK(a->mmap_lock);
+    LOCK(a->heap_lock);
+    purged += purge_heaps(a, &keep, UINT64_MAX);
+    UNLOCK(a->heap_lock);
+    STATS_ADD(a->stats.purged_bytes, purged);
+    return purged;
+}
+
+uint64_t coarse_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// at most once per ALLO_DECAY_MS, halve the mmap cache and give back the free
+// memory of heaps that went a whole pass without being used
+void allo_decay(allocator *a) {
+#if ALLO_DECAY_MS > 0
+    if (a->backing != NULL)
+        return;
+    uint64_t now = coarse_now_ns();
+    uint64_t next = __atomic_load_n(&a->next_decay, __ATOMIC_RELAXED);
+    if (now < next
+        || !__atomic_compare_exchange_n(&a->next_decay, &next,
+                                        now + ALLO_DECAY_MS * 1000000ull, false,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        return;
+    // the first call only starts the clock
+    if (next == 0)
+        return;
+
+    LOCK(a->mmap_lock);
+    size_t keep = a->stats.mmap_cache_bytes / 2;
+    size_t purged = mmap_cache_purge(a, &keep);
+    UNLOCK(a->mmap_lock);
+
+    LOCK(a->heap_lock);
+    uint64_t epoch = ++a->decay_epoch;
+    keep = 0;
+    purged += purge_heaps(a, &keep, epoch - 1);
+    UNLOCK(a->heap_lock);
+    STATS_ADD(a->stats.purged_bytes, purged);
+#else
+    (void)a;
+#endif
+}
+
+// zero, if not NULL, is set to the part of the result known to be zero
+void *allo_cate_zero_span(allocator *a, size_t size, zero_span *zero) {
     debug_printf("allo_cate: %lu\n", size);
     debug_print_allocator_state(a);
-    avl_tree_debug_print(a->free_chunk_tree);
+    free_index_debug_print(a);
+
+    if (__atomic_load_n(&a->remote_frees, __ATOMIC_RELAXED) != NULL)
+        allo_reclaim_remote_frees(a);
 
     void *res = NULL;
 
     size_t to_alloc = round_to_alloc_size_without_metadata(size);
-    if (to_alloc <= MAX_ARENA_SIZE) {
+    arena_free_chunk *c;
+    if (to_alloc <= MAX_ARENA_SIZE && zero != NULL
+        && allo_cate_arena_zeroed_list(a, to_alloc, 1, &c) == 1) {
+        res = c;
+        *zero = (zero_span){(uint64_t)(c + 1), (uint64_t)c + to_alloc};
+    } else if (to_alloc <= MAX_ARENA_SIZE) {
         res = allo_cate_arena(a, to_alloc);
     } else if (to_alloc >= MIN_MMAP) {
-        res = allo_cate_mmaped(a, to_alloc);
+        res = allo_cate_mmaped(a, to_alloc, zero);
     } else {
-        res = allo_cate_standard(a, to_alloc);
+        res = allo_cate_standard(a, to_alloc, zero);
     }
 
     debug_printf("allo_cate result: %p\n", res);
-    avl_tree_debug_print(a->free_chunk_tree);
+    free_index_debug_print(a);
     debug_printf("END allo_cate: %lu\n", size);
 
     return res;
 }
 
-void allo_free_arena(allocator *a, chunk *ch) {
-    if (ch == NULL)
-        return;
-    debug_printf("allo_free_arena: %lu\n", ARENA_CHUNK_SIZE(ch->status));
-    arena *arena = &a->arenas[get_arena_bucket(ARENA_CHUNK_SIZE(ch->status))];
-    ch->status |= FREE;
-    arena_free_chunk *c = (arena_free_chunk *)ch;
-    c->next = arena->free_list;
-    arena->free_list = c;
+void *allo_cate(allocator *a, size_t size) {
+    return allo_cate_zero_span(a, size, NULL);
 }
 
-void allo_free_mmaped(allocator *a, void *p) {
-    mmapped_chunk *c = (mmapped_chunk *)((char *)p - sizeof(mmapped_chunk));
-    debug_printf("allo_free_mmaped: %lu\n", CHUNK_SIZE(c->status));
+// smallest arena size whose objects are align aligned and fit size bytes, 0
+// if there is none
+uint64_t arena_aligned_size(size_t align, size_t size) {
+    if (size > MAX_ARENA_SIZE || align > MAX_ARENA_SIZE)
+        return 0;
+    size = (size + align - 1) & ~(align - 1);
+    for (uint64_t bucket = get_arena_bucket(size); bucket < NUM_ARENA_BUCKETS;
+         bucket++) {
+        if ((arena_bucket_size(bucket) & (align - 1)) == 0)
+            return arena_bucket_size(bucket);
+    }
+    return 0;
+}
 
-    if (c->prev) {
-        c->prev->next = c->next;
-    } else {
-        a->mmapped_chunk_head = c->next;
+void *allo_cate_aligned(allocator *a, size_t align, size_t size) {
+    if (align == 0 || (align & (align - 1)) != 0)
+        return NULL;
+    uint64_t arena_size = arena_aligned_size(align, size);
+    if (arena_size != 0)
+        return allo_cate(a, arena_size);
+    // everything past the arenas is CHUNK_SIZE_ALIGN aligned
+    if (align <= CHUNK_SIZE_ALIGN)
+        return allo_cate(a, size);
+    if (size > SIZE_MAX / 2 || align > SIZE_MAX / 4)
+        return NULL;
+
+    if (__atomic_load_n(&a->remote_frees, __ATOMIC_RELAXED) != NULL)
+        allo_reclaim_remote_frees(a);
+
+    size_t to_alloc = ROUND_SIZE_TO_ALIGN(size);
+    if (to_alloc <= MAX_ARENA_SIZE)
+        to_alloc = MAX_ARENA_SIZE + CHUNK_SIZE_ALIGN;
+    if (to_alloc + align + MIN_ALIGN_GAP < MIN_MMAP)
+        return allo_cate_standard_aligned(a, align, to_alloc);
+    return allo_cate_mmaped_aligned(a, align, size);
+}
+
+void *allo_calloc(allocator *a, size_t nmemb, size_t size) {
+    size_t n;
+    if (__builtin_mul_overflow(nmemb, size, &n))
+        return NULL;
+    zero_span zero = {0, 0};
+    char *res = allo_cate_zero_span(a, n, &zero);
+    if (res == NULL)
+        return NULL;
+
+    // clear what is outside the zero span
+    uint64_t start = (uint64_t)res, end = (uint64_t)res + n;
+    if (zero.start >= zero.end || zero.start >= end || zero.end <= start) {
+        memset(res, 0, n);
+        STATS_ADD(a->stats.calloc_cleared_bytes, n);
+        return res;
+    }
+    if (zero.start > start) {
+        memset(res, 0, zero.start - start);
+        STATS_ADD(a->stats.calloc_cleared_bytes, zero.start - start);
+    }
+    if (zero.end < end) {
+        memset((void *)zero.end, 0, end - zero.end);
+        STATS_ADD(a->stats.calloc_cleared_bytes, end - zero.end);
     }
+    return res;
+}
 
-    if (c->next)
-        c->next->prev = c->prev;
+void allo_free_arena(allocator *a, void *p, uint64_t bucket) {
+    debug_printf("allo_free_arena: %lu\n", arena_bucket_size(bucket));
+    arena *arena = &a->arenas[bucket];
+    LOCK(arena->lock);
+    bool released = slab_put(a, arena, p);
+    UNLOCK(arena->lock);
+    if (released)
+        allo_decay(a);
+}
+
+// aligned chunks don't start right before their data, so c comes from the
+// page map
+void allo_free_mmaped(allocator *a, mmapped_chunk *c) {
+    debug_printf("allo_free_mmaped: %lu\n", CHUNK_SIZE(c->status));
 
     size_t size = CHUNK_SIZE(c->status);
-    a->stats.num_bytes_allocated -= size;
-    munmap(c, size);
+    STATS_SUB(a->stats.num_bytes_allocated, size);
+    pagemap_clear(c, size);
+
+    LOCK(a->mmap_lock);
+    mmapped_unlink(a, c);
+    bool cached = mmap_cache_put(a, c);
+    UNLOCK(a->mmap_lock);
+
+    if (!cached)
+        munmap(c, size);
+    allo_decay(a);
 }
 
 void allo_free_standard(allocator *a, void *p) {
     heap_chunk *ch = to_heap_chunk(p);
     debug_printf("allo_free_standard: %lu\n", CHUNK_SIZE(ch->status));
+    STATS_SUB(a->stats.num_bytes_allocated, CHUNK_SIZE(ch->status));
+    LOCK(a->heap_lock);
+    heap_of(ch)->epoch = a->decay_epoch;
     ch->status |= FREE;
     coalesce(a, ch);
+    UNLOCK(a->heap_lock);
+    allo_decay(a);
 }
 
 void allo_free(allocator *a, void *p) {
     if (p == NULL)
         return;
-    chunk *c = to_chunk(p);
 
-    if (ARENA_CHUNK_SIZE(c->status) <= MAX_ARENA_SIZE) {
-        allo_free_arena(a, c);
-    } else if (c->status & MMAPPED) {
-        allo_free_mmaped(a, p);
+    pagemap_entry entry = pagemap_get(p);
+    switch (PAGEMAP_KIND(entry)) {
+    case PAGE_SLAB:
+        allo_free_arena(a, p, PAGEMAP_SIZE_CLASS(entry));
+        break;
+    case PAGE_HEAP:
+        allo_free_standard(a, p);
+        break;
+    case PAGE_MMAPPED:
+        allo_free_mmaped(a, PAGEMAP_SPAN(entry));
+        break;
+    default:
+        debug_assert(false);
+    }
+}
+
+// resize the medium chunk at p without moving it, growing into the next chunk
+// if that is free. false if there isn't room
+bool allo_realloc_standard(allocator *a, void *p, size_t to_alloc) {
+    heap_chunk *c = to_heap_chunk(p);
+    LOCK(a->heap_lock);
+    size_t old_size = SIZE(c);
+    if (old_size < to_alloc) {
+        heap_chunk *next = next_chunk(c);
+        if (next == NULL || !IS_FREE(next->status)
+            || old_size + sizeof(heap_chunk) + SIZE(next) < to_alloc) {
+            UNLOCK(a->heap_lock);
+            return false;
+        }
+        free_index_remove(a, next);
+        heap_chunk *next_again = next_chunk(next);
+        if (next_again)
+            next_again->prev = c;
+        c->status = old_size + sizeof(heap_chunk) + SIZE(next);
+    }
+    heap_of(c)->epoch = a->decay_epoch;
+    split_chunk(a, c, to_alloc);
+    size_t new_size = SIZE(c);
+    if (heap_of(c)->untouched < (uint64_t)c->data + new_size)
+        heap_of(c)->untouched = (uint64_t)c->data + new_size;
+    UNLOCK(a->heap_lock);
+
+    STATS_ADD(a->stats.num_bytes_allocated, new_size);
+    STATS_SUB(a->stats.num_bytes_allocated, old_size);
+    return true;
+}
+
+// move the mapping rather than the bytes. NULL (and p left alone) on failure
+void *allo_realloc_mmaped(allocator *a, void *p, size_t size) {
+    mmapped_chunk *c = (mmapped_chunk *)((char *)p - sizeof(mmapped_chunk));
+    size_t old_size = CHUNK_SIZE(c->status);
+    size_t to_alloc =
+        (size + sizeof(struct mmapped_chunk) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    if (to_alloc == old_size)
+        return p;
+    debug_printf("allo_realloc_mmaped: %lu -> %lu\n", old_size, to_alloc);
+
+    LOCK(a->mmap_lock);
+    mmapped_unlink(a, c);
+    UNLOCK(a->mmap_lock);
+    pagemap_clear(c, old_size);
+
+    mmapped_chunk *res = mremap(c, old_size, to_alloc, MREMAP_MAYMOVE);
+    if (res != MAP_FAILED
+        && !pagemap_set(res, to_alloc, res, PAGE_MMAPPED, 0)) {
+        // may move again, the contents are what matter
+        c = mremap(res, to_alloc, old_size, MREMAP_MAYMOVE);
+        res = MAP_FAILED;
+    }
+    if (res == MAP_FAILED) {
+        pagemap_set(c, old_size, c, PAGE_MMAPPED, 0);
+        LOCK(a->mmap_lock);
+        mmapped_link(a, c);
+        UNLOCK(a->mmap_lock);
+        return NULL;
+    }
+
+    res->status = to_alloc | MMAPPED;
+    LOCK(a->mmap_lock);
+    mmapped_link(a, res);
+    UNLOCK(a->mmap_lock);
+    STATS_ADD(a->stats.num_bytes_allocated, to_alloc);
+    STATS_SUB(a->stats.num_bytes_allocated, old_size);
+    return res->data;
+}
+
+void *allo_realloc(allocator *a, void *p, size_t size) {
+    if (p == NULL)
+        return allo_cate(a, size);
+    debug_printf("allo_realloc: %p %lu\n", p, size);
+
+    size_t to_alloc = round_to_alloc_size_without_metadata(size);
+    pagemap_entry entry = pagemap_get(p);
+    switch (PAGEMAP_KIND(entry)) {
+    case PAGE_SLAB:
+        if (to_alloc <= MAX_ARENA_SIZE
+            && get_arena_bucket(to_alloc) == PAGEMAP_SIZE_CLASS(entry))
+            return p;
+        break;
+    case PAGE_HEAP:
+        if (to_alloc > MAX_ARENA_SIZE && to_alloc < MIN_MMAP
+            && allo_realloc_standard(a, p, to_alloc))
+            return p;
+        break;
+    case PAGE_MMAPPED:
+        // aligned chunks have to keep their data offset, and a file's
+        // chunks their place in the file, so those move
+        if (to_alloc >= MIN_MMAP && a->backing == NULL
+            && PAGEMAP_SPAN(entry) == (char *)p - sizeof(mmapped_chunk)) {
+            void *res = allo_realloc_mmaped(a, p, to_alloc);
+            if (res != NULL)
+                return res;
+        }
+        break;
+    default:
+        debug_assert(false);
+    }
+
+    void *res = allo_cate(a, size);
+    if (res == NULL)
+        return NULL;
+    size_t old_size = introspect_size(p);
+    memcpy(res, p, old_size < size ? old_size : size);
+    allo_free(a, p);
+    return res;
+}
+
+size_t allo_cate_batch(allocator *a, size_t size, void **out, size_t n) {
+    if (__atomic_load_n(&a->remote_frees, __ATOMIC_RELAXED) != NULL)
+        allo_reclaim_remote_frees(a);
+
+    size_t to_alloc = round_to_alloc_size_without_metadata(size);
+    size_t done = 0;
+    if (to_alloc > MAX_ARENA_SIZE) {
+        for (; done < n; done++) {
+            out[done] = allo_cate(a, size);
+            if (out[done] == NULL)
+                break;
+        }
+        return done;
+    }
+
+    while (done < n) {
+        arena_free_chunk *head;
+        size_t taken = allo_cate_arena_list(a, to_alloc, n - done, &head);
+        if (taken == 0)
+            break;
+        for (; head != NULL; head = head->next)
+            out[done++] = head;
+    }
+    return done;
+}
+
+void allo_free_batch(allocator *a, void **ptrs, size_t n) {
+    arena_free_chunk *heads[NUM_ARENA_BUCKETS] = {0};
+    arena_free_chunk *tails[NUM_ARENA_BUCKETS];
+    size_t counts[NUM_ARENA_BUCKETS] = {0};
+
+    for (size_t i = 0; i < n; i++) {
+        if (ptrs[i] == NULL)
+            continue;
+        pagemap_entry entry = pagemap_get(ptrs[i]);
+        if (PAGEMAP_KIND(entry) != PAGE_SLAB) {
+            allo_free(a, ptrs[i]);
+            continue;
+        }
+        uint64_t bucket = PAGEMAP_SIZE_CLASS(entry);
+        arena_free_chunk *c = ptrs[i];
+        c->next = heads[bucket];
+        if (heads[bucket] == NULL)
+            tails[bucket] = c;
+        heads[bucket] = c;
+        counts[bucket]++;
+    }
+
+    for (uint64_t bucket = 0; bucket < NUM_ARENA_BUCKETS; bucket++) {
+        if (counts[bucket] > 0)
+            allo_free_arena_list(a, bucket, heads[bucket], tails[bucket],
+                                 counts[bucket]);
+    }
+}
+
+void allo_free_sized(allocator *a, void *p, size_t size) {
+    if (p == NULL)
+        return;
+
+    size_t to_alloc = round_to_alloc_size_without_metadata(size);
+    debug_assert(introspect_size(p) >= size);
+    if (to_alloc <= MAX_ARENA_SIZE) {
+        debug_assert(PAGEMAP_KIND(pagemap_get(p)) == PAGE_SLAB);
+        debug_assert(PAGEMAP_SIZE_CLASS(pagemap_get(p))
+                     == get_arena_bucket(to_alloc));
+        allo_free_arena(a, p, get_arena_bucket(to_alloc));
+    } else if (to_alloc >= MIN_MMAP) {
+        debug_assert(PAGEMAP_KIND(pagemap_get(p)) == PAGE_MMAPPED);
+        debug_assert(PAGEMAP_SPAN(pagemap_get(p))
+                     == (char *)p - sizeof(mmapped_chunk));
+        allo_free_mmaped(a, (mmapped_chunk *)((char *)p - sizeof(mmapped_chunk)));
     } else {
+        debug_assert(PAGEMAP_KIND(pagemap_get(p)) == PAGE_HEAP);
         allo_free_standard(a, p);
     }
 }
 
+allocator *allo_owner(void *p) {
+    pagemap_entry entry = pagemap_get(p);
+    switch (PAGEMAP_KIND(entry)) {
+    case PAGE_HEAP:
+        return ((heap *)PAGEMAP_SPAN(entry))->owner;
+    case PAGE_SLAB:
+    case PAGE_CACHE:
+        return heap_of(PAGEMAP_SPAN(entry))->owner;
+    case PAGE_MMAPPED:
+        return ((mmapped_chunk *)PAGEMAP_SPAN(entry))->owner;
+    default:
+        return NULL;
+    }
+}
+
+bool allo_owns(allocator *a, void *p) { return p && allo_owner(p) == a; }
+
+void allo_free_remote(allocator *owner, void *p) {
+    void **link = p;
+    void *head = __atomic_load_n(&owner->remote_frees, __ATOMIC_RELAXED);
+    do {
+        *link = head;
+    } while (!__atomic_compare_exchange_n(&owner->remote_frees, &head, p, true,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+void allo_reclaim_remote_frees(allocator *a) {
+    // only the owner pops, and it takes the whole stack so there is no ABA
+    void *p = __atomic_exchange_n(&a->remote_frees, NULL, __ATOMIC_ACQUIRE);
+    while (p != NULL) {
+        void *next = *(void **)p;
+        allo_free(a, p);
+        p = next;
+    }
+}
+
 void initialize_allocator(allocator *a) {
+    LOCK_INIT(a->heap_lock);
+    LOCK_INIT(a->mmap_lock);
     a->heaps = NULL;
-    a->free_chunk_tree = NULL;
+    for (size_t i = 0; i < MMAP_CACHE_BINS; i++)
+        a->mmap_cache[i] = NULL;
+    a->slab_heaps = NULL;
+    a->free_slabs = NULL;
+    free_index_init(a);
     a->mmapped_chunk_head = NULL;
+    a->remote_frees = NULL;
+    a->next_abandoned = NULL;
+    a->next_decay = 0;
+    a->decay_epoch = 0;
+    a->backing = NULL;
+    a->numa_node = -1;
     initialize_stats(&a->stats);
     for (size_t i = 0; i < NUM_ARENA_BUCKETS; i++) {
-        a->arenas[i].arena_block_head = NULL;
-        a->arenas[i].free_list = NULL;
+        LOCK_INIT(a->arenas[i].lock);
+        a->arenas[i].partial_slabs = NULL;
+        a->arenas[i].num_empty_slabs = 0;
+        LOCK_INIT(a->transfer_caches[i].lock);
+        a->transfer_caches[i].num_batches = 0;
     }
 }
 
-void free_allocator(allocator *a) {
+bool allo_reattach(allocator *a) {
+    LOCK_INIT(a->heap_lock);
+    LOCK_INIT(a->mmap_lock);
     for (size_t i = 0; i < NUM_ARENA_BUCKETS; i++) {
-        arena *arena = &a->arenas[i];
-        arena_block *block_next = NULL;
-        for (arena_block *b = arena->arena_block_head; b != NULL;
-             b = block_next) {
-            block_next = b->next;
-            allo_free(a, b);
+        LOCK_INIT(a->arenas[i].lock);
+        LOCK_INIT(a->transfer_caches[i].lock);
+    }
+    a->next_abandoned = NULL;
+    a->next_decay = 0;
+
+    for (heap *h = a->heaps; h != NULL; h = h->next) {
+        if (!pagemap_set(h, HEAP_SIZE, h, PAGE_HEAP, 0))
+            return false;
+    }
+    for (heap *h = a->slab_heaps; h != NULL; h = h->next) {
+        for (size_t i = 0; i < HEAP_SIZE / SLAB_SIZE; i++) {
+            char *start = (char *)h + i * SLAB_SIZE;
+            slab *s = slab_of(start);
+            if (s->kind == PAGE_NONE)
+                continue;
+            uint32_t size_class =
+                s->kind == PAGE_SLAB ? get_arena_bucket(s->size) : 0;
+            if (!pagemap_set(start, SLAB_SIZE, start, s->kind, size_class))
+                return false;
         }
-        arena->arena_block_head = NULL;
-        arena->free_list = NULL;
+    }
+    for (mmapped_chunk *c = a->mmapped_chunk_head; c != NULL; c = c->next) {
+        if (!pagemap_set(c, CHUNK_SIZE(c->status), c, PAGE_MMAPPED, 0))
+            return false;
+    }
+
+    // frees other threads of the last process handed over
+    allo_reclaim_remote_frees(a);
+    return true;
+}
+
+void free_allocator(allocator *a) {
+    // persistent heaps are closed with allo_close_persistent
+    debug_assert(a->backing == NULL);
+    tcache_discard(a);
+    a->remote_frees = NULL;
+    for (size_t i = 0; i < NUM_ARENA_BUCKETS; i++) {
+        a->arenas[i].partial_slabs = NULL;
+        a->arenas[i].num_empty_slabs = 0;
+        a->transfer_caches[i].num_batches = 0;
     }
 
     heap *heap_next;
     for (heap *h = a->heaps; h != NULL; h = heap_next) {
         heap_next = h->next;
+        pagemap_clear(h, HEAP_SIZE);
+        munmap(h, HEAP_SIZE);
+    }
+    for (heap *h = a->slab_heaps; h != NULL; h = heap_next) {
+        heap_next = h->next;
+        pagemap_clear(h, HEAP_SIZE);
         munmap(h, HEAP_SIZE);
     }
     mmapped_chunk *chunk_next;
     for (mmapped_chunk *c = a->mmapped_chunk_head; c != NULL; c = chunk_next) {
         chunk_next = c->next;
+        pagemap_clear(c, CHUNK_SIZE(c->status));
         munmap(c, CHUNK_SIZE(c->status));
     }
-    a->free_chunk_tree = NULL;
+    for (size_t i = 0; i < MMAP_CACHE_BINS; i++) {
+        for (mmapped_chunk *c = a->mmap_cache[i]; c != NULL; c = chunk_next) {
+            chunk_next = c->next;
+            munmap(c, CHUNK_SIZE(c->status));
+        }
+        a->mmap_cache[i] = NULL;
+    }
+    free_index_init(a);
     a->mmapped_chunk_head = NULL;
     a->heaps = NULL;
+    a->slab_heaps = NULL;
+    a->free_slabs = NULL;
     initialize_stats(&a->stats);
 
-    avl_tree_debug_print(a->free_chunk_tree);
+    free_index_debug_print(a);
 }
 
 size_t introspect_size(void *p) {
-    return CHUNK_SIZE(((chunk *)((char *)p - sizeof(chunk)))->status);
+    pagemap_entry entry = pagemap_get(p);
+    switch (PAGEMAP_KIND(entry)) {
+    case PAGE_SLAB:
+    case PAGE_CACHE:
+        return slab_of(p)->size;
+    case PAGE_MMAPPED:
+        return (char *)PAGEMAP_SPAN(entry)
+               + CHUNK_SIZE(((mmapped_chunk *)PAGEMAP_SPAN(entry))->status)
+               - (char *)p;
+    default:
+        return SIZE(to_heap_chunk(p));
+    }
 }
 
 // malloc etc.
+// all zero locks are valid PTHREAD_MUTEX_INITIALIZERs
 allocator global_allocator = {0};
 
-void *_allo_malloc(size_t size) { return allo_cate(&global_allocator, size); }
+void *_allo_malloc(size_t size) {
+#ifdef ALLO_THREAD_HEAPS
+    return allo_thread_cate(size);
+#endif
+#if defined(ALLO_PERCPU) || defined(ALLO_TCACHE)
+    size_t to_alloc = round_to_alloc_size_without_metadata(size);
+    if (to_alloc <= MAX_ARENA_SIZE) {
+#ifdef ALLO_PERCPU
+        void *res = percpu_allo_cate(&global_allocator, to_alloc);
+        if (res != NULL)
+            return res;
+#endif
+#ifdef ALLO_TCACHE
+        return tcache_allo_cate(&global_allocator, to_alloc);
+#endif
+    }
+#endif
+    return allo_cate(&global_allocator, size);
+}
 
-void _allo_free(void *p) { allo_free(&global_allocator, p); }
+void _allo_free(void *p) {
+    if (p == NULL)
+        return;
+#ifdef ALLO_THREAD_HEAPS
+    allo_thread_free(p);
+    return;
+#endif
+#if defined(ALLO_PERCPU) || defined(ALLO_TCACHE)
+    pagemap_entry entry = pagemap_get(p);
+    if (PAGEMAP_KIND(entry) == PAGE_SLAB) {
+        uint64_t bucket = PAGEMAP_SIZE_CLASS(entry);
+#ifdef ALLO_PERCPU
+        if (percpu_free(&global_allocator, p, bucket))
+            return;
+#endif
+#ifdef ALLO_TCACHE
+        tcache_free(&global_allocator, p, bucket);
+        return;
+#endif
+    }
+#endif
+    allo_free(&global_allocator, p);
+}
+
+void _allo_free_sized(void *p, size_t size) {
+    if (p == NULL)
+        return;
+#ifdef ALLO_THREAD_HEAPS
+    allo_thread_free(p);
+    return;
+#endif
+#if defined(ALLO_PERCPU) || defined(ALLO_TCACHE)
+    size_t to_alloc = round_to_alloc_size_without_metadata(size);
+    if (to_alloc <= MAX_ARENA_SIZE) {
+        uint64_t bucket = get_arena_bucket(to_alloc);
+        debug_assert(PAGEMAP_SIZE_CLASS(pagemap_get(p)) == bucket);
+#ifdef ALLO_PERCPU
+        if (percpu_free(&global_allocator, p, bucket))
+            return;
+#endif
+#ifdef ALLO_TCACHE
+        tcache_free(&global_allocator, p, bucket);
+        return;
+#endif
+    }
+#endif
+    allo_free_sized(&global_allocator, p, size);
+}
 
 void *_allo_realloc(void *p, size_t size) {
     if (p == NULL)
         return _allo_malloc(size);
-    if (introspect_size(p) >= size)
+#ifdef ALLO_THREAD_HEAPS
+    allocator *a = allo_thread_allocator();
+#else
+    allocator *a = &global_allocator;
+#endif
+    pagemap_entry entry = pagemap_get(p);
+    // slab objects may belong to a cache, so those only stay put or move
+    if (PAGEMAP_KIND(entry) != PAGE_SLAB && allo_owner(p) == a)
+        return allo_realloc(a, p, size);
+
+    size_t to_alloc = round_to_alloc_size_without_metadata(size);
+    if (PAGEMAP_KIND(entry) == PAGE_SLAB && to_alloc <= MAX_ARENA_SIZE
+        && get_arena_bucket(to_alloc) == PAGEMAP_SIZE_CLASS(entry))
         return p;
     void *new_p = _allo_malloc(size);
-    memcpy(new_p, p, introspect_size(p));
+    if (new_p == NULL)
+        return NULL;
+    size_t old_size = introspect_size(p);
+    memcpy(new_p, p, old_size < size ? old_size : size);
     _allo_free(p);
     return new_p;
 }
 
 void *_allo_calloc(size_t nmemb, size_t size) {
-    void *p = _allo_malloc(nmemb * size);
-    memset(p, 0, nmemb * size);
-    return p;
+    size_t n;
+    if (__builtin_mul_overflow(nmemb, size, &n))
+        return NULL;
+#ifdef ALLO_THREAD_HEAPS
+    allocator *a = allo_thread_allocator();
+    return a == NULL ? NULL : allo_calloc(a, nmemb, size);
+#endif
+#if defined(ALLO_PERCPU) || defined(ALLO_TCACHE)
+    // small sizes come out of the caches like malloc, clearing a cached
+    // object is cheaper than a trip to the arena for one known to be zero
+    size_t to_alloc = round_to_alloc_size_without_metadata(n);
+    if (to_alloc <= MAX_ARENA_SIZE) {
+#ifdef ALLO_ZERO_POOL
+        return tcache_allo_cate_zeroed(&global_allocator, to_alloc);
+#endif
+        void *res = _allo_malloc(n);
+        if (res != NULL)
+            memset(res, 0, n);
+        return res;
+    }
+#endif
+    return allo_calloc(&global_allocator, nmemb, size);
+}
+
+// small alignments are served by picking an arena size with naturally
+// aligned objects, so they still go through the caches
+void *_allo_aligned(size_t align, size_t size) {
+#ifdef ALLO_THREAD_HEAPS
+    allocator *a = allo_thread_allocator();
+    return a == NULL ? NULL : allo_cate_aligned(a, align, size);
+#endif
+    uint64_t arena_size = arena_aligned_size(align, size);
+    if (arena_size != 0)
+        return _allo_malloc(arena_size);
+    if (align <= CHUNK_SIZE_ALIGN)
+        return _allo_malloc(size);
+    return allo_cate_aligned(&global_allocator, align, size);
+}
+
+int _allo_posix_memalign(void **memptr, size_t align, size_t size) {
+    if (align < sizeof(void *) || (align & (align - 1)) != 0)
+        return EINVAL;
+    void *p = _allo_aligned(align, size);
+    if (p == NULL)
+        return ENOMEM;
+    *memptr = p;
+    return 0;
+}
+
+void *_allo_aligned_alloc(size_t align, size_t size) {
+    if (align == 0 || (align & (align - 1)) != 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    return _allo_aligned(align, size);
+}
+
+void *_allo_memalign(size_t align, size_t size) {
+    return _allo_aligned_alloc(align, size);
+}
+
+void _allo_free_aligned_sized(void *p, size_t align, size_t size) {
+    uint64_t arena_size = arena_aligned_size(align, size);
+    if (arena_size != 0)
+        _allo_free_sized(p, arena_size);
+    else
+        _allo_free(p);
 }
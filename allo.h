@@ -1,36 +1,67 @@
 #ifndef ALLO_H
 #define ALLO_H
 
+#include <pthread.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
 #include "stats.h"
 
+#ifdef __cplusplus
+// flexible array members are a C feature g++ accepts but warns about
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+extern "C" {
+#endif
+
 /* #define __ALLO_DEBUG_PRINT */
 /* #define __ALLO_STATE_DEBUG */
 /* #define __ALLO_DEBUG_ASSERT */
 #define ALLO_OVERRIDE_MALLOC
+// allo_cate/allo_free may be called concurrently on the same allocator. Each
+// arena bucket, the heaps (medium path and free tree) and the mmapped chunk
+// list have their own lock
+#define ALLO_THREAD_SAFE
+// small malloc/free on the global allocator go through thread-local caches
+#define ALLO_TCACHE
+// malloc/free use an allocator owned by the calling thread instead of the
+// global allocator, see thread_allocator.h
+/* #define ALLO_THREAD_HEAPS */
+// small malloc/free go through per-CPU caches when rseq is available, see
+// percpu.h, falling back to the thread caches otherwise
+/* #define ALLO_PERCPU */
+// index free heap chunks with a two level segregated fit (see tlsf/tlsf.h)
+// instead of the AVL tree
+/* #define ALLO_TLSF */
+// calloc of small sizes on the global allocator comes from a thread-local
+// pool of objects still zero from a fresh or purged slab (needs ALLO_TCACHE)
+/* #define ALLO_ZERO_POOL */
 
 // Arenas are allocated for all sizes <= MAX_ARENA_SIZE bytes.
-// sizes are powers of two when >= 124 bytes
+// sizes go up in ARENA_SIZE_ALIGN steps to ARENA_DOUBLING_SIZE, then split
+// every doubling into ARENA_CLASSES_PER_DOUBLING evenly spaced sizes
 #define MAX_ARENA_POWER (10)
 #define MAX_ARENA_SIZE (1 << MAX_ARENA_POWER)
 #define ARENA_DOUBLING_POWER (7)
 #define ARENA_DOUBLING_SIZE (1 << ARENA_DOUBLING_POWER)
+#define ARENA_CLASSES_PER_DOUBLING 4
 #define NUM_ARENA_BUCKETS                                                      \
-    ((ARENA_DOUBLING_SIZE / ARENA_SIZE_ALIGN)                                  \
-     - (MIN_ALLOC_SIZE / ARENA_SIZE_ALIGN - 1)                                 \
-     + (MAX_ARENA_POWER - ARENA_DOUBLING_POWER))
+    ((ARENA_DOUBLING_SIZE - MIN_ALLOC_SIZE) / ARENA_SIZE_ALIGN + 1             \
+     + (MAX_ARENA_POWER - ARENA_DOUBLING_POWER) * ARENA_CLASSES_PER_DOUBLING)
 
 #define PAGE_SIZE 4096
 
-#define ARENA_GROWTH_FACTOR 16
+// arena objects live in SLAB_SIZE aligned spans of one size class, carved out
+// of heaps of their own
+#define SLAB_SIZE (PAGE_SIZE * 4)
+// empty slabs an arena holds on to before giving them back for any size class
+#define ARENA_WARM_SLABS 1
 
-// each heap
+// each heap, heaps are mapped at HEAP_SIZE aligned addresses
 #define HEAP_SIZE (PAGE_SIZE * 32)
 
-// 16 bytes
-#define MIN_ALLOC_SIZE (sizeof(struct arena_free_chunk))
+#define MIN_ALLOC_SIZE 16
 
 // directly mmap requests >= this size
 // size at which you can't store two of the same thing on a heap
@@ -38,17 +69,25 @@
 // x > HEAP_SIZE / 2 - sizeof(chunk)
 #define MIN_MMAP ((HEAP_SIZE - sizeof(struct heap)) / 2 - sizeof(struct chunk))
 
-// 5 bits of flags, 4th bit unused
-#define CHUNK_SIZE_ALIGN (1 << 5)
+// free heap memory untouched for about this long is given back to the OS, 0
+// leaves it to allo_trim
+#define ALLO_DECAY_MS 1000
+
+// freed mmapped chunks are kept mapped for reuse up to this many bytes in
+// total, in bins of sizes within a power of two of each other
+#define MMAP_CACHE_BUDGET (32 << 20)
+#define MMAP_CACHE_BINS 10
 
-// 3 bits of flags, 1st and 2nd unused
+// 4 bits of flags, see enum chunk_status
+#define CHUNK_SIZE_ALIGN (1 << 4)
+
+// arena sizes up to ARENA_DOUBLING_SIZE are multiples of this
 #define ARENA_SIZE_ALIGN (1 << 3)
 
 #define ROUND_SIZE_TO_ALIGN(x)                                                 \
     (((x) + CHUNK_SIZE_ALIGN - 1) & ~(CHUNK_SIZE_ALIGN - 1))
 
 #define CHUNK_SIZE(status) ((status) & ~(CHUNK_SIZE_ALIGN - 1))
-#define ARENA_CHUNK_SIZE(status) ((status) & ~(ARENA_SIZE_ALIGN - 1))
 
 typedef struct chunk {
     size_t status;
@@ -56,17 +95,16 @@ typedef struct chunk {
 } chunk;
 
 typedef struct mmapped_chunk {
+    struct allocator *owner;
     struct mmapped_chunk *prev;
     struct mmapped_chunk *next;
     size_t status;
     char data[];
 } mmapped_chunk;
 
-// should be size 32 so alignment isn't aids
-// I guess size_t is bad
+// 16 bytes so data stays 16 byte aligned. the links of free chunks live in
+// their payload, see free_chunk_tree and free_chunk_list
 typedef struct heap_chunk {
-    uint64_t _padding;
-    struct free_chunk_list *next_of_size;
     struct heap_chunk *prev;
     size_t status;
     char data[];
@@ -81,6 +119,8 @@ enum chunk_status {
     FREE = 1,
     TREE = 2,
     MMAPPED = 4,
+    // free chunk whose whole pages were given back with madvise
+    PURGED = 8,
 };
 
 #define IS_ARENA(status) ((status)&ARENA)
@@ -88,78 +128,260 @@ enum chunk_status {
 #define IS_FREE(status) ((status)&FREE)
 #define IS_MMAPPED(status) ((status)&MMAPPED)
 
-// sorted in an rb tree
+// sorted in an rb tree. everything after status is in the chunk's payload
 typedef struct free_chunk_tree {
-    uint64_t height;
-    struct free_chunk_list *next_of_size;
     heap_chunk *prev;
     size_t status;
+    uint64_t height;
+    struct free_chunk_list *next_of_size;
     // 0 for left, 1 for right
     struct free_chunk_tree *child[2];
 } free_chunk_tree;
 
+// next_of_size overlaps the tree's so a tree node heads its list of chunks of
+// the same size
 typedef struct free_chunk_list {
-    free_chunk *prev_of_size;
-    struct free_chunk_list *next_of_size;
     heap_chunk *prev;
     size_t status;
+    free_chunk *prev_of_size;
+    struct free_chunk_list *next_of_size;
 } free_chunk_list;
 
+// second level bins per power of two
+#define TLSF_SL_BITS 4
+#define TLSF_SL_COUNT (1 << TLSF_SL_BITS)
+// sizes below 1 << TLSF_FL_SHIFT share the first first level bin
+#define TLSF_FL_SHIFT (TLSF_SL_BITS + 4)
+// enough for any chunk inside a heap
+#define TLSF_FL_COUNT 10
+
+typedef struct tlsf_index {
+    uint32_t fl_bitmap;
+    uint32_t sl_bitmap[TLSF_FL_COUNT];
+    free_chunk *bins[TLSF_FL_COUNT][TLSF_SL_COUNT];
+} tlsf_index;
+
+// free arena objects outside their slab (in the thread, per-CPU and transfer
+// caches) are linked through their first word
 typedef struct arena_free_chunk {
-    size_t status;
     struct arena_free_chunk *next;
 } arena_free_chunk;
 
-// malloc larger blocks to subdivide for the arenas
-typedef struct arena_block {
-    struct arena_block *prev;
-    struct arena_block *next;
-    char data[];
-} arena_block;
+// Header of a span of objects of one arena size packed back to back, with no
+// per-object header. Set bits of the bitmap are free slots, slabs with a free
+// slot are linked into their arena. The page map records the size class of
+// every slab page so frees can tell slab objects apart.
+//
+// The header sits at the start of the slab, after the heap header for the
+// first slab of a heap.
+typedef struct slab {
+    struct slab *prev;
+    struct slab *next;
+    uint32_t size;
+    uint32_t num_slots;
+    uint32_t num_free;
+    // offset of the first object from the slab
+    uint32_t objects;
+    // page map kind while in use, PAGE_NONE while free
+    uint32_t kind;
+    // offset from the slab past which its memory is still zero: nothing
+    // there was handed out since it was mapped or purged. kept while free
+    uint32_t zero_from;
+    uint64_t bitmap[];
+} slab;
+
+#ifdef ALLO_THREAD_SAFE
+typedef pthread_mutex_t allo_mutex;
+#define LOCK(m) pthread_mutex_lock(&(m))
+#define UNLOCK(m) pthread_mutex_unlock(&(m))
+#define LOCK_INIT(m) pthread_mutex_init(&(m), NULL)
+#else
+typedef char allo_mutex;
+#define LOCK(m) ((void)(m))
+#define UNLOCK(m) ((void)(m))
+#define LOCK_INIT(m) ((void)(m))
+#endif
 
 typedef struct arena {
-    struct arena_block *arena_block_head;
-    struct arena_free_chunk *free_list;
+    allo_mutex lock;
+    // slabs with at least one free slot
+    struct slab *partial_slabs;
+    // of which are completely free
+    uint64_t num_empty_slabs;
 } arena;
 
+// number of chunks in a batch moved between thread caches and the allocator
+#define TRANSFER_BATCH 32
+// full batches each arena bucket holds on to
+#define TRANSFER_SLOTS 16
+
+// central cache of whole batches of free chunks per bucket, so a batch freed
+// by one thread is handed to another with a single lock round trip and
+// without walking or splitting the arena free list
+typedef struct transfer_cache {
+    allo_mutex lock;
+    uint64_t num_batches;
+    // NULL terminated lists of TRANSFER_BATCH chunks
+    struct arena_free_chunk *batches[TRANSFER_SLOTS];
+} transfer_cache;
+
 typedef struct heap {
     struct heap *prev;
     struct heap *next;
-    uint64_t allocated_bytes;
+    union {
+        // bytes of slabs in use, for slab heaps
+        uint64_t allocated_bytes;
+        // no chunk past here has been handed out, so apart from the links
+        // of the free chunk there the rest of the heap is still zero
+        uint64_t untouched;
+    };
     uint64_t end_of_heap;
+    struct allocator *owner;
+    // decay epoch of the last allocation or free in the heap
+    uint64_t epoch;
+    // epoch when all of the heap's free chunks were last found purged, they
+    // needn't be looked at again until epoch moves on
+    uint64_t purged_epoch;
+    uint64_t _padding[1];
     char free_chunks[];
 } heap;
 
 typedef struct allocator {
-    stats stats;
+    // heaps, slab heaps and the free chunk index
+    allo_mutex heap_lock;
+    allo_mutex mmap_lock;
+    struct stats stats;
     heap *heaps;
+    // freed mmapped chunks still mapped, under mmap_lock
+    mmapped_chunk *mmap_cache[MMAP_CACHE_BINS];
+    // heaps split into slabs, and the slabs no arena is using. a free slab
+    // with size 0 had its pages purged
+    heap *slab_heaps;
+    slab *free_slabs;
     mmapped_chunk *mmapped_chunk_head;
-    free_chunk_tree *free_chunk_tree;
+#ifdef ALLO_TLSF
+    tlsf_index tlsf;
+#else
+    struct free_chunk_tree *free_chunk_tree;
+#endif
     arena arenas[NUM_ARENA_BUCKETS];
+    transfer_cache transfer_caches[NUM_ARENA_BUCKETS];
+    // lock-free stack of pointers freed by threads other than the owner,
+    // linked through their first word and reclaimed on the next allo_cate
+    void *remote_frees;
+    // time (CLOCK_MONOTONIC_COARSE ns) of the next decay pass and the number
+    // of passes so far
+    uint64_t next_decay;
+    uint64_t decay_epoch;
+    // set while no thread owns this allocator, see thread_allocator.c
+    struct allocator *next_abandoned;
+    // the file this allocator lives in, NULL for anonymous memory. see
+    // persistent.h
+    struct allo_persistent *backing;
+    // NUMA node its memory is bound to, -1 for none. see numa.h
+    int numa_node;
 } allocator;
 
 void initialize_allocator(allocator *a);
 void free_allocator(allocator *a);
+// make an allocator mapped in from elsewhere usable by this process: reset
+// its locks and record its memory in the page map. false if the page map
+// couldn't grow
+bool allo_reattach(allocator *a);
 
 void *allo_cate(allocator *a, size_t size);
 void allo_free(allocator *a, void *p);
+// nmemb * size zeroed bytes, NULL if that overflows. memory fresh from the
+// OS isn't cleared again
+void *allo_calloc(allocator *a, size_t nmemb, size_t size);
+// size bytes at an align aligned address, align a power of two. NULL if
+// align isn't one
+void *allo_cate_aligned(allocator *a, size_t align, size_t size);
+// free p given the size it was allocated (or last reallocated) with, which
+// picks the path without looking p up. not for allo_cate_aligned memory
+void allo_free_sized(allocator *a, void *p, size_t size);
+// up to n objects of size bytes into out, returns how many. small sizes are
+// taken from the slabs a run at a time
+size_t allo_cate_batch(allocator *a, size_t size, void **out, size_t n);
+// free n pointers (NULLs are skipped), with one arena list splice per size
+// class
+void allo_free_batch(allocator *a, void **ptrs, size_t n);
+// resize p, in place when the next chunk is free or when shrinking, and with
+// mremap rather than a copy for mmapped chunks. p is left alone on failure
+void *allo_realloc(allocator *a, void *p, size_t size);
 size_t introspect_size(void *p);
+// whether p points into memory a handed out, without touching p's memory
+bool allo_owns(allocator *a, void *p);
+// give free memory back to the OS, keeping at most keep_bytes of it mapped.
+// batches in the transfer caches and warm empty slabs are released first,
+// then the mmap cache goes, then free heaps, then free runs inside heaps.
+// returns the number of bytes given back
+size_t allo_trim(allocator *a, size_t keep_bytes);
+// time based trimming, runs on frees that release memory (see ALLO_DECAY_MS)
+void allo_decay(allocator *a);
 
 void debug_printf(const char *fmt, ...);
 
+// allocator that p was allocated from, NULL if it isn't allo's
+allocator *allo_owner(void *p);
+// free p on behalf of its owner from any thread, lock-free
+void allo_free_remote(allocator *owner, void *p);
+// free everything other threads handed to allo_free_remote
+void allo_reclaim_remote_frees(allocator *a);
+
+// arena internals shared with the thread caches. whole TRANSFER_BATCH
+// batches go through the transfer caches
+uint64_t round_to_alloc_size_without_metadata(size_t n);
+uint64_t get_arena_bucket(uint64_t size);
+uint64_t arena_bucket_size(uint64_t bucket);
+size_t allo_cate_arena_list(allocator *a, size_t to_alloc, size_t n,
+                            arena_free_chunk **head);
+// the same, only objects that are zero apart from their link. may come up
+// short (or empty) when the arena only has used memory left
+size_t allo_cate_arena_zeroed_list(allocator *a, size_t to_alloc, size_t n,
+                                   arena_free_chunk **head);
+void allo_free_arena_list(allocator *a, uint64_t bucket, arena_free_chunk *head,
+                          arena_free_chunk *tail, size_t n);
+
+// slab internals shared with the object caches, see cache.h. the slab of a
+// cache is recorded as PAGE_CACHE, so allo_free won't take its objects
+slab *slab_of(void *p);
+slab *cache_slab_new(allocator *a, uint32_t size, uint32_t align);
+void *slab_take_one(slab *s);
+void slab_return(slab *s, void *p);
+// give an empty slab s (unlinked from everything) back to a
+void slab_release(allocator *a, slab *s);
+
 // malloc etc.
 extern allocator global_allocator;
 
 void *_allo_malloc(size_t size);
 void _allo_free(void *p);
+void _allo_free_sized(void *p, size_t size);
 void *_allo_calloc(size_t nmemb, size_t size);
 void *_allo_realloc(void *ptr, size_t size);
+int _allo_posix_memalign(void **memptr, size_t align, size_t size);
+void *_allo_aligned_alloc(size_t align, size_t size);
+void *_allo_memalign(size_t align, size_t size);
+void _allo_free_aligned_sized(void *p, size_t align, size_t size);
+// align any power of two, without posix_memalign's restrictions
+void *_allo_aligned(size_t align, size_t size);
 
 #ifdef ALLO_OVERRIDE_MALLOC
 #define malloc(x) _allo_malloc(x)
 #define free(x) _allo_free(x)
+#define free_sized(x, y) _allo_free_sized(x, y)
+#define free_aligned_sized(x, y, z) _allo_free_aligned_sized(x, y, z)
 #define calloc(x, y) _allo_calloc(x, y)
 #define realloc(x, y) _allo_realloc(x, y)
+#define posix_memalign(p, x, y) _allo_posix_memalign(p, x, y)
+#define aligned_alloc(x, y) _allo_aligned_alloc(x, y)
+#define memalign(x, y) _allo_memalign(x, y)
+#endif
+
+#ifdef __cplusplus
+}
+#pragma GCC diagnostic pop
 #endif
 
 #endif
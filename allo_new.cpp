@@ -0,0 +1,133 @@
+#include <cstddef>
+#include <new>
+
+#include "allo.h"
+
+// Replacements for every global operator new/delete, on top of
+// global_allocator. Link allo_new.o into a C++ program to use it; it isn't
+// part of allo.a, which stays plain C.
+
+namespace {
+
+// new never returns null: on failure the new_handler gets a chance to free
+// something up and we retry, with no handler it's bad_alloc
+void *allo_new(std::size_t size) {
+    for (;;) {
+        void *p = _allo_malloc(size);
+        if (p != nullptr)
+            return p;
+        std::new_handler handler = std::get_new_handler();
+        if (handler == nullptr)
+            throw std::bad_alloc();
+        handler();
+    }
+}
+
+void *allo_new_aligned(std::size_t size, std::align_val_t align) {
+    for (;;) {
+        void *p = _allo_aligned(static_cast<std::size_t>(align), size);
+        if (p != nullptr)
+            return p;
+        std::new_handler handler = std::get_new_handler();
+        if (handler == nullptr)
+            throw std::bad_alloc();
+        handler();
+    }
+}
+
+// the nothrow forms still run the new_handler, they only swallow bad_alloc
+// (which the handler may throw too)
+void *allo_new_nothrow(std::size_t size) noexcept {
+    try {
+        return allo_new(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void *allo_new_aligned_nothrow(std::size_t size,
+                               std::align_val_t align) noexcept {
+    try {
+        return allo_new_aligned(size, align);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+} // namespace
+
+void *operator new(std::size_t size) { return allo_new(size); }
+
+void *operator new[](std::size_t size) { return allo_new(size); }
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+    return allo_new_nothrow(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+    return allo_new_nothrow(size);
+}
+
+void *operator new(std::size_t size, std::align_val_t align) {
+    return allo_new_aligned(size, align);
+}
+
+void *operator new[](std::size_t size, std::align_val_t align) {
+    return allo_new_aligned(size, align);
+}
+
+void *operator new(std::size_t size, std::align_val_t align,
+                   const std::nothrow_t &) noexcept {
+    return allo_new_aligned_nothrow(size, align);
+}
+
+void *operator new[](std::size_t size, std::align_val_t align,
+                     const std::nothrow_t &) noexcept {
+    return allo_new_aligned_nothrow(size, align);
+}
+
+void operator delete(void *p) noexcept { _allo_free(p); }
+
+void operator delete[](void *p) noexcept { _allo_free(p); }
+
+void operator delete(void *p, const std::nothrow_t &) noexcept {
+    _allo_free(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept {
+    _allo_free(p);
+}
+
+// the compiler passes the size given to new, so small objects go straight
+// back to their size class without looking p up
+void operator delete(void *p, std::size_t size) noexcept {
+    _allo_free_sized(p, size);
+}
+
+void operator delete[](void *p, std::size_t size) noexcept {
+    _allo_free_sized(p, size);
+}
+
+void operator delete(void *p, std::align_val_t) noexcept { _allo_free(p); }
+
+void operator delete[](void *p, std::align_val_t) noexcept { _allo_free(p); }
+
+void operator delete(void *p, std::align_val_t,
+                     const std::nothrow_t &) noexcept {
+    _allo_free(p);
+}
+
+void operator delete[](void *p, std::align_val_t,
+                       const std::nothrow_t &) noexcept {
+    _allo_free(p);
+}
+
+void operator delete(void *p, std::size_t size,
+                     std::align_val_t align) noexcept {
+    _allo_free_aligned_sized(p, static_cast<std::size_t>(align), size);
+}
+
+void operator delete[](void *p, std::size_t size,
+                       std::align_val_t align) noexcept {
+    _allo_free_aligned_sized(p, static_cast<std::size_t>(align), size);
+}
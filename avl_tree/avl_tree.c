@@ -38,16 +38,18 @@ free_chunk_tree *rotate_dir(free_chunk_tree *root, int dir) {
 #define rotate_left_opt(P) (P ? rotate_left(P) : NULL)
 #define rotate_right_opt(P) (P ? rotate_right(P) : NULL)
 
+// smallest node with SIZE(node) >= size
 free_chunk_tree *_avl_tree_search(free_chunk_tree *root, size_t size) {
+    free_chunk_tree *best = NULL;
     free_chunk_tree *node = root;
     while (node != NULL) {
-        if ((size < SIZE(node) && node->child[LEFT] == NULL)
-            || size == SIZE(node))
+        if (size == SIZE(node))
             return node;
-        else
-            node = node->child[size > SIZE(node)];
+        if (size < SIZE(node))
+            best = node;
+        node = node->child[size > SIZE(node)];
     }
-    return NULL;
+    return best;
 }
 
 free_chunk *avl_tree_search(free_chunk_tree *root, size_t size) {
@@ -57,7 +59,7 @@ free_chunk *avl_tree_search(free_chunk_tree *root, size_t size) {
 }
 
 free_chunk_tree *init(free_chunk_tree *node) {
-    node->height = 1;
+    node->height = 0;
     node->status |= TREE | FREE;
     node->next_of_size = NULL;
     node->child[LEFT] = NULL;
@@ -118,28 +120,28 @@ free_chunk_tree *avl_tree_insert(free_chunk_tree *h,
     return rebalance(h);
 }
 
-free_chunk_tree *min_elt(free_chunk_tree *h, free_chunk_tree *parent,
-                         free_chunk_tree **save_parent) {
-    if (h == NULL)
-        return NULL;
-    while (h->left != NULL) {
-        parent = h;
-        h = h->left;
+// detach the smallest node of h into *min
+free_chunk_tree *remove_min(free_chunk_tree *h, free_chunk_tree **min) {
+    if (h->left == NULL) {
+        *min = h;
+        return h->right;
     }
-    *save_parent = parent;
-    return h;
+    h->left = remove_min(h->left, min);
+    return rebalance(h);
 }
 
-void full_switch(free_chunk_tree *a, free_chunk_tree *b) {
-    uint64_t height = a->height;
-    free_chunk_tree *l = a->left;
-    free_chunk_tree *r = a->right;
-    a->left = b->left;
-    a->right = b->right;
-    a->height = b->height;
-    b->height = height;
-    b->left = l;
-    b->right = r;
+// the first chunk of h's list of same size chunks takes h's place in the tree
+free_chunk_tree *promote_next_of_size(free_chunk_tree *h) {
+    free_chunk_tree *promoted = (free_chunk_tree *)h->next_of_size;
+    free_chunk_list *rest = h->next_of_size->next_of_size;
+    if (rest)
+        rest->prev_of_size = (free_chunk *)promoted;
+    promoted->next_of_size = rest;
+    promoted->status |= TREE;
+    promoted->height = h->height;
+    promoted->left = h->left;
+    promoted->right = h->right;
+    return promoted;
 }
 
 free_chunk_tree *avl_tree_remove(free_chunk_tree *h, size_t size) {
@@ -147,44 +149,30 @@ free_chunk_tree *avl_tree_remove(free_chunk_tree *h, size_t size) {
         return NULL;
     }
 
-    int64_t compare = size - SSIZE(h);
-    if (compare == 0) {
-        if (!h->left && !h->right) {
-            return NULL;
-        } else if (h->left && !h->right) {
-            return h->left;
-        } else if (!h->left && h->right) {
-            return h->right;
-        } else {
-            free_chunk_tree *parent = NULL;
-            free_chunk_tree *min = min_elt(h->right, h, &parent);
-            if (parent != h)
-                parent->left = h;
-            free_chunk_tree *tmp = h->right;
-            h->right = min->right;
-            if (min != tmp)
-                min->right = tmp;
-            else
-                min->right = NULL;
-            min->left = h->left;
-            h->left = NULL;
-            min->right = avl_tree_remove(min->right, SIZE(h));
-            return rebalance(min);
-        }
-    } else if (compare < 0) {
-        if (!h->left)
-            return h;
+    if (size < SIZE(h)) {
         h->left = avl_tree_remove(h->left, size);
         return rebalance(h);
-    } else {
-        if (!h->right)
-            return h;
+    } else if (size > SIZE(h)) {
         h->right = avl_tree_remove(h->right, size);
         return rebalance(h);
     }
+
+    if (h->next_of_size)
+        return promote_next_of_size(h);
+    if (!h->left)
+        return h->right;
+    if (!h->right)
+        return h->left;
+
+    free_chunk_tree *min = NULL;
+    free_chunk_tree *rest = remove_min(h->right, &min);
+    min->left = h->left;
+    min->right = rest;
+    return rebalance(min);
 }
 
 free_chunk_tree *avl_tree_remove_node(free_chunk_tree *h, free_chunk *node) {
+    // sizes are unique in the tree, so node is the one removed
     if (IS_TREE(node->status))
         return avl_tree_remove(h, SIZE(node));
     free_chunk_list *list = (free_chunk_list *)node;
@@ -246,7 +234,8 @@ bool avl_tree_contains(tree_node *root, node *node) {
 }
 
 void avl_tree_debug_print(free_chunk_tree *root) {
-#ifdef ALLO_AVL_DEBUG
+// walking the tree is O(n), and unlocked callers race with other threads
+#if defined(ALLO_AVL_DEBUG) && defined(__ALLO_DEBUG_PRINT)
     debug_printf("RB Tree:\n");
     print_avl_tree_helper(root, 0);
     debug_printf("END RB Tree:\n");
@@ -13,7 +13,6 @@ void test_avl_tree_insert(void) {
     for (unsigned i = 0; i < TEST_SIZE; i++) {
         nodes[i].status = i * 32u;
         nodes[i].child[0] = nodes[i].child[1] = NULL;
-        nodes[i].parent = NULL;
 
         root = avl_tree_insert(root, &nodes[i]);
     }
@@ -30,7 +29,6 @@ void test_avl_tree_remove(void) {
     for (unsigned i = 0; i < TEST_SIZE; i++) {
         nodes[i].status = i * 32;
         nodes[i].child[0] = nodes[i].child[1] = NULL;
-        nodes[i].parent = NULL;
         root = avl_tree_insert(root, &nodes[i]);
     }
 
@@ -53,7 +51,6 @@ void test_avl_tree_remove_node(void) {
     for (unsigned i = 0; i < TEST_SIZE; i++) {
         nodes[i].status = i * 32;
         nodes[i].child[0] = nodes[i].child[1] = NULL;
-        nodes[i].parent = NULL;
         root = avl_tree_insert(root, &nodes[i]);
     }
 
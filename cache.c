@@ -0,0 +1,123 @@
+#include "cache.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "allo.h"
+
+allo_cache *allo_cache_create(allocator *a, size_t size, size_t align,
+                              void (*ctor)(void *), void (*dtor)(void *)) {
+    if (align == 0)
+        align = ARENA_SIZE_ALIGN;
+    size = (size + align - 1) & ~(align - 1);
+    if (size == 0 || size > ALLO_CACHE_MAX_SIZE
+        || (align & (align - 1)) != 0)
+        return NULL;
+
+    allo_cache *c = allo_cate(a, sizeof(allo_cache));
+    if (c == NULL)
+        return NULL;
+    c->a = a;
+    LOCK_INIT(c->lock);
+    c->size = size;
+    c->align = align;
+    c->ctor = ctor;
+    c->dtor = dtor;
+    c->partial_slabs = NULL;
+    c->full_slabs = NULL;
+    c->num_empty_slabs = 0;
+    return c;
+}
+
+static void unlink_slab(slab **list, slab *s) {
+    if (s->prev != NULL)
+        s->prev->next = s->next;
+    else
+        *list = s->next;
+    if (s->next != NULL)
+        s->next->prev = s->prev;
+}
+
+static void push_slab(slab **list, slab *s) {
+    s->prev = NULL;
+    s->next = *list;
+    if (*list != NULL)
+        (*list)->prev = s;
+    *list = s;
+}
+
+static void slab_objects(slab *s, void (*f)(void *)) {
+    char *objects = (char *)s + s->objects;
+    for (uint32_t i = 0; i < s->num_slots; i++)
+        f(objects + i * s->size);
+}
+
+// with the cache locked
+static bool cache_grow(allo_cache *c) {
+    uint32_t align =
+        c->align > ALLO_CACHE_LINE ? c->align : ALLO_CACHE_LINE;
+    slab *s = cache_slab_new(c->a, c->size, align);
+    if (s == NULL)
+        return false;
+    if (c->ctor != NULL)
+        slab_objects(s, c->ctor);
+    push_slab(&c->partial_slabs, s);
+    c->num_empty_slabs++;
+    return true;
+}
+
+static void cache_release(allo_cache *c, slab *s) {
+    if (c->dtor != NULL)
+        slab_objects(s, c->dtor);
+    slab_release(c->a, s);
+}
+
+void *allo_cache_get(allo_cache *c) {
+    LOCK(c->lock);
+    if (c->partial_slabs == NULL && !cache_grow(c)) {
+        UNLOCK(c->lock);
+        return NULL;
+    }
+    slab *s = c->partial_slabs;
+    if (s->num_free == s->num_slots)
+        c->num_empty_slabs--;
+    void *p = slab_take_one(s);
+    if (s->num_free == 0) {
+        unlink_slab(&c->partial_slabs, s);
+        push_slab(&c->full_slabs, s);
+    }
+    UNLOCK(c->lock);
+    return p;
+}
+
+void allo_cache_put(allo_cache *c, void *p) {
+    slab *s = slab_of(p);
+    LOCK(c->lock);
+    slab_return(s, p);
+    if (s->num_free == 1) {
+        unlink_slab(&c->full_slabs, s);
+        push_slab(&c->partial_slabs, s);
+    }
+    if (s->num_free == s->num_slots) {
+        if (c->num_empty_slabs < ALLO_CACHE_WARM_SLABS) {
+            c->num_empty_slabs++;
+        } else {
+            unlink_slab(&c->partial_slabs, s);
+            cache_release(c, s);
+        }
+    }
+    UNLOCK(c->lock);
+}
+
+void allo_cache_destroy(allo_cache *c) {
+    slab *next;
+    for (slab *s = c->partial_slabs; s != NULL; s = next) {
+        next = s->next;
+        cache_release(c, s);
+    }
+    for (slab *s = c->full_slabs; s != NULL; s = next) {
+        next = s->next;
+        cache_release(c, s);
+    }
+    allo_free(c->a, c);
+}
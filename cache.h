@@ -0,0 +1,48 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "allo.h"
+
+// Caches of objects of one type, each with slabs of its own packed with
+// objects of exactly its size. Objects are constructed once when their slab
+// is made and destructed when it is given back, so a put object keeps its
+// constructed state for the next get. Free objects are tracked in the slab
+// bitmaps only, nothing is written into them.
+//
+// Objects start on a cache line boundary in every slab. Pass ALLO_CACHE_LINE
+// as the alignment to give every object lines of its own.
+
+#define ALLO_CACHE_LINE 64
+// biggest object a cache takes, so every slab holds a few
+#define ALLO_CACHE_MAX_SIZE (SLAB_SIZE / 8)
+// empty slabs a cache keeps constructed before giving them back
+#define ALLO_CACHE_WARM_SLABS 1
+
+typedef struct allo_cache {
+    allocator *a;
+    allo_mutex lock;
+    uint32_t size;
+    uint32_t align;
+    void (*ctor)(void *);
+    void (*dtor)(void *);
+    // slabs with at least one free slot, and the rest
+    slab *partial_slabs;
+    slab *full_slabs;
+    uint64_t num_empty_slabs;
+} allo_cache;
+
+// align is a power of two (0 for 8), ctor and dtor may be NULL. NULL if size
+// is over ALLO_CACHE_MAX_SIZE or a is out of memory
+allo_cache *allo_cache_create(allocator *a, size_t size, size_t align,
+                              void (*ctor)(void *), void (*dtor)(void *));
+// a constructed object, NULL if out of memory
+void *allo_cache_get(allo_cache *c);
+// p must be back in its constructed state
+void allo_cache_put(allo_cache *c, void *p);
+// every object must have been put back
+void allo_cache_destroy(allo_cache *c);
+
+#endif
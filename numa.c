@@ -0,0 +1,189 @@
+#define _GNU_SOURCE
+#include "numa.h"
+
+#include <errno.h>
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "allo.h"
+
+#define MASK_WORD_BITS (8 * sizeof(unsigned long))
+
+static allocator node_allocators[ALLO_MAX_NUMA_NODES];
+// nodes with memory we are allowed to use, each has an allocator
+static uint64_t memory_nodes;
+// where memory for the CPUs of each node comes from, the node itself unless
+// it has no memory (or none for us)
+static int home_nodes[ALLO_MAX_NUMA_NODES];
+static int num_nodes = 1;
+static pthread_once_t numa_once = PTHREAD_ONCE_INIT;
+// cleared when the kernel won't mbind for us at all, so nothing keeps
+// retrying it
+static bool mbind_works = true;
+// nodes mbind refused, the others are still bound
+static uint64_t unbindable_nodes;
+
+// node lists look like "0-1,3", 0 if there is no such file
+static uint64_t read_nodes(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL)
+        return 0;
+    uint64_t nodes = 0;
+    int first, last;
+    while (fscanf(f, "%d", &first) == 1) {
+        last = first;
+        int c = fgetc(f);
+        if (c == '-') {
+            if (fscanf(f, "%d", &last) != 1)
+                break;
+            c = fgetc(f);
+        }
+        for (int node = first; node <= last && node < ALLO_MAX_NUMA_NODES;
+             node++)
+            nodes |= 1ull << node;
+        if (c != ',')
+            break;
+    }
+    fclose(f);
+    return nodes;
+}
+
+// nodes with memory, less those outside our cpuset (which mbind refuses)
+static uint64_t usable_nodes(void) {
+    uint64_t nodes = read_nodes("/sys/devices/system/node/has_memory");
+    if (nodes == 0)
+        nodes = read_nodes("/sys/devices/system/node/online");
+    unsigned long allowed[ALLO_MAX_NUMA_NODES / MASK_WORD_BITS] = {0};
+    if (syscall(SYS_get_mempolicy, NULL, allowed, ALLO_MAX_NUMA_NODES + 1,
+                NULL, MPOL_F_MEMS_ALLOWED)
+        == 0) {
+        uint64_t in_cpuset = 0;
+        for (int node = 0; node < ALLO_MAX_NUMA_NODES; node++) {
+            if (allowed[node / MASK_WORD_BITS] & (1ul << node % MASK_WORD_BITS))
+                in_cpuset |= 1ull << node;
+        }
+        if ((nodes & in_cpuset) != 0)
+            nodes &= in_cpuset;
+    }
+    return nodes == 0 ? 1 : nodes;
+}
+
+// the usable node closest to node by the kernel's distance table, which has
+// a distance to every online node in order
+static int nearest_node(int node, uint64_t online) {
+    int best = __builtin_ctzll(memory_nodes);
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/distance",
+             node);
+    FILE *f = fopen(path, "r");
+    if (f == NULL)
+        return best;
+    int best_distance = -1;
+    int distance;
+    for (int other = 0; other < ALLO_MAX_NUMA_NODES; other++) {
+        if (!(online & (1ull << other)))
+            continue;
+        if (fscanf(f, "%d", &distance) != 1)
+            break;
+        if ((memory_nodes & (1ull << other))
+            && (best_distance < 0 || distance < best_distance)) {
+            best = other;
+            best_distance = distance;
+        }
+    }
+    fclose(f);
+    return best;
+}
+
+static void numa_init(void) {
+    memory_nodes = usable_nodes();
+    num_nodes = 64 - __builtin_clzll(memory_nodes);
+    for (int node = 0; node < num_nodes; node++) {
+        if (!(memory_nodes & (1ull << node)))
+            continue;
+        initialize_allocator(&node_allocators[node]);
+        node_allocators[node].numa_node = node;
+    }
+    uint64_t online = read_nodes("/sys/devices/system/node/online");
+    for (int node = 0; node < ALLO_MAX_NUMA_NODES; node++) {
+        home_nodes[node] = memory_nodes & (1ull << node)
+                               ? node
+                               : nearest_node(node, online);
+    }
+}
+
+int allo_numa_nodes(void) {
+    pthread_once(&numa_once, numa_init);
+    return num_nodes;
+}
+
+int allo_numa_current_node(void) {
+    pthread_once(&numa_once, numa_init);
+    unsigned cpu, node;
+    if (getcpu(&cpu, &node) != 0 || node >= ALLO_MAX_NUMA_NODES)
+        return home_nodes[0];
+    return home_nodes[node];
+}
+
+allocator *allo_numa_allocator(int node) {
+    pthread_once(&numa_once, numa_init);
+    if (node < 0 || node >= num_nodes || !(memory_nodes & (1ull << node)))
+        return NULL;
+    return &node_allocators[node];
+}
+
+bool allo_numa_bound(int node) {
+    return node >= 0 && node < ALLO_MAX_NUMA_NODES
+           && __atomic_load_n(&mbind_works, __ATOMIC_RELAXED)
+           && !(__atomic_load_n(&unbindable_nodes, __ATOMIC_RELAXED)
+                & (1ull << node));
+}
+
+void *allo_cate_on_node(int node, size_t size) {
+    allocator *a = allo_numa_allocator(node);
+    if (a == NULL)
+        return NULL;
+    if (node == allo_numa_current_node())
+        STATS_ADD(a->stats.numa_local_allocations, 1);
+    else
+        STATS_ADD(a->stats.numa_remote_allocations, 1);
+    return allo_cate(a, size);
+}
+
+void *allo_numa_cate(size_t size) {
+    return allo_cate_on_node(allo_numa_current_node(), size);
+}
+
+void allo_numa_free(void *p) {
+    if (p == NULL)
+        return;
+    allocator *owner = allo_owner(p);
+    if (owner != NULL)
+        allo_free(owner, p);
+}
+
+bool numa_bind(void *p, size_t size, int node) {
+    if (!allo_numa_bound(node))
+        return false;
+    unsigned long mask[ALLO_MAX_NUMA_NODES / MASK_WORD_BITS] = {0};
+    mask[node / MASK_WORD_BITS] = 1ul << (node % MASK_WORD_BITS);
+    if (syscall(SYS_mbind, p, size, MPOL_PREFERRED, mask,
+                ALLO_MAX_NUMA_NODES + 1, 0)
+        == 0)
+        return true;
+    // no NUMA in the kernel or a seccomp filter, that won't change. EINVAL
+    // is about this node (no memory, outside the cpuset), anything else may
+    // well pass next time
+    if (errno == ENOSYS || errno == EPERM)
+        __atomic_store_n(&mbind_works, false, __ATOMIC_RELAXED);
+    else if (errno == EINVAL)
+        __atomic_fetch_or(&unbindable_nodes, 1ull << node, __ATOMIC_RELAXED);
+    return false;
+}
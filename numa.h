@@ -0,0 +1,40 @@
+#ifndef NUMA_H
+#define NUMA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "allo.h"
+
+// An allocator per NUMA node with memory we may use (in has_memory and the
+// cpuset), whose heaps, slab heaps and mmapped chunks are bound to that node
+// with mbind (MPOL_PREFERRED, so a full node still falls back to the
+// others). CPUs on a memoryless node use the nearest node that has some.
+// Frees go back to whichever node's allocator owns the pointer.
+//
+// Machines with a single node get a single allocator. If the kernel refuses
+// mbind altogether (no NUMA support, seccomp) memory is simply left unbound,
+// if it only refuses one node, only that node's is.
+
+#define ALLO_MAX_NUMA_NODES 64
+
+// highest node with an allocator + 1, at least 1
+int allo_numa_nodes(void);
+// node the calling thread's CPU gets memory from: its own, or the nearest
+// with memory
+int allo_numa_current_node(void);
+// NULL if node has no allocator
+allocator *allo_numa_allocator(int node);
+// whether memory for node is still being bound to it
+bool allo_numa_bound(int node);
+// memory on node, counted as local or remote in that node's stats depending
+// on the calling CPU. NULL if node has no allocator
+void *allo_cate_on_node(int node, size_t size);
+// memory on the calling CPU's node
+void *allo_numa_cate(size_t size);
+void allo_numa_free(void *p);
+
+// bind [p, p + size) to node, false if the kernel wouldn't
+bool numa_bind(void *p, size_t size, int node);
+
+#endif
@@ -0,0 +1,90 @@
+#include "pagemap.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+typedef struct pagemap_leaf {
+    pagemap_entry entries[1 << PAGEMAP_LEAF_BITS];
+} pagemap_leaf;
+
+typedef struct pagemap_mid {
+    pagemap_leaf *leaves[1 << PAGEMAP_MID_BITS];
+} pagemap_mid;
+
+static pagemap_mid *root[1 << PAGEMAP_ROOT_BITS];
+
+#define ROOT_INDEX(page) ((page) >> (PAGEMAP_LEAF_BITS + PAGEMAP_MID_BITS))
+#define MID_INDEX(page)                                                        \
+    (((page) >> PAGEMAP_LEAF_BITS) & ((1 << PAGEMAP_MID_BITS) - 1))
+#define LEAF_INDEX(page) ((page) & ((1 << PAGEMAP_LEAF_BITS) - 1))
+
+// nodes are never freed, a racing thread that loses the CAS unmaps its own
+static void *get_or_create(void **slot, size_t size) {
+    void *node = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+    if (node != NULL)
+        return node;
+
+    void *fresh = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (fresh == MAP_FAILED)
+        return NULL;
+    if (__atomic_compare_exchange_n(slot, &node, fresh, false,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        return fresh;
+    munmap(fresh, size);
+    return node;
+}
+
+static pagemap_entry *entry_for(uint64_t page, bool create) {
+    if (ROOT_INDEX(page) >= (1 << PAGEMAP_ROOT_BITS))
+        return NULL;
+
+    void **mid_slot = (void **)&root[ROOT_INDEX(page)];
+    pagemap_mid *mid = create ? get_or_create(mid_slot, sizeof(pagemap_mid))
+                              : __atomic_load_n(mid_slot, __ATOMIC_ACQUIRE);
+    if (mid == NULL)
+        return NULL;
+
+    void **leaf_slot = (void **)&mid->leaves[MID_INDEX(page)];
+    pagemap_leaf *leaf = create
+                             ? get_or_create(leaf_slot, sizeof(pagemap_leaf))
+                             : __atomic_load_n(leaf_slot, __ATOMIC_ACQUIRE);
+    if (leaf == NULL)
+        return NULL;
+    return &leaf->entries[LEAF_INDEX(page)];
+}
+
+static void set_range(void *start, size_t len, pagemap_entry entry,
+                      bool create) {
+    uint64_t first = (uint64_t)start >> PAGEMAP_PAGE_BITS;
+    uint64_t last = ((uint64_t)start + len - 1) >> PAGEMAP_PAGE_BITS;
+    for (uint64_t page = first; page <= last; page++) {
+        pagemap_entry *e = entry_for(page, create);
+        if (e != NULL)
+            __atomic_store_n(e, entry, __ATOMIC_RELEASE);
+    }
+}
+
+bool pagemap_set(void *start, size_t len, void *span, enum page_kind kind,
+                uint32_t size_class) {
+    // make sure every node exists first so a failure leaves nothing behind
+    uint64_t first = (uint64_t)start >> PAGEMAP_PAGE_BITS;
+    uint64_t last = ((uint64_t)start + len - 1) >> PAGEMAP_PAGE_BITS;
+    for (uint64_t page = first; page <= last;
+         page = (page | ((1 << PAGEMAP_LEAF_BITS) - 1)) + 1)
+        if (entry_for(page, true) == NULL)
+            return false;
+
+    set_range(start, len,
+              (uint64_t)span | ((uint64_t)size_class << 4) | kind, false);
+    return true;
+}
+
+void pagemap_clear(void *start, size_t len) { set_range(start, len, 0, false); }
+
+pagemap_entry pagemap_get(const void *p) {
+    pagemap_entry *e = entry_for((uint64_t)p >> PAGEMAP_PAGE_BITS, false);
+    return e == NULL ? 0 : __atomic_load_n(e, __ATOMIC_ACQUIRE);
+}
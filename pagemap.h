@@ -0,0 +1,50 @@
+#ifndef PAGEMAP_H
+#define PAGEMAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Process wide radix tree from page number to the span owning the page, its
+// kind and size class, so a pointer can be classified without reading the
+// memory in front of it.
+//
+// An entry is the page aligned span address with the kind and size class
+// packed into its low bits, 0 for pages allo didn't hand out.
+
+// bits of user space addresses covered
+#define PAGEMAP_ADDRESS_BITS 47
+#define PAGEMAP_PAGE_BITS 12
+#define PAGEMAP_LEAF_BITS 12
+#define PAGEMAP_MID_BITS 12
+#define PAGEMAP_ROOT_BITS                                                      \
+    (PAGEMAP_ADDRESS_BITS - PAGEMAP_PAGE_BITS - PAGEMAP_LEAF_BITS              \
+     - PAGEMAP_MID_BITS)
+
+enum page_kind {
+    PAGE_NONE = 0,
+    // part of a heap, the span is the heap
+    PAGE_HEAP = 1,
+    // part of an mmapped chunk, the span is the mmapped_chunk
+    PAGE_MMAPPED = 2,
+    // part of a slab inside a heap, the span is the slab and the size class
+    // its arena bucket
+    PAGE_SLAB = 3,
+    // part of a slab of an object cache, the span is the slab
+    PAGE_CACHE = 4,
+};
+
+typedef uint64_t pagemap_entry;
+
+#define PAGEMAP_KIND(entry) ((enum page_kind)((entry)&0xf))
+#define PAGEMAP_SIZE_CLASS(entry) ((uint32_t)(((entry) >> 4) & 0xff))
+#define PAGEMAP_SPAN(entry) ((void *)((entry) & ~(uint64_t)0xfff))
+
+// record span, kind and size class for every page of [start, start + len),
+// false if the radix tree couldn't grow
+bool pagemap_set(void *start, size_t len, void *span, enum page_kind kind,
+                uint32_t size_class);
+void pagemap_clear(void *start, size_t len);
+pagemap_entry pagemap_get(const void *p);
+
+#endif
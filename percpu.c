@@ -0,0 +1,212 @@
+#include "percpu.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/sysinfo.h>
+
+#include "allo.h"
+
+#if defined(__x86_64__) && __has_include(<sys/rseq.h>)
+#include <sys/rseq.h>
+#define HAVE_RSEQ
+#endif
+
+#ifdef HAVE_RSEQ
+
+// signature glibc registers rseq with, has to precede every abort handler
+#define RSEQ_SIG 0x53053053
+#define STRINGIFY_(x) #x
+#define STRINGIFY(x) STRINGIFY_(x)
+
+// descriptor of the critical section between labels 1 and 2 that aborts to 4,
+// installed into rseq->rseq_cs before it starts
+#define RSEQ_CS_START                                                          \
+    ".pushsection __rseq_cs, \"aw\"\n\t"                                       \
+    ".balign 32\n\t"                                                           \
+    "3:\n\t"                                                                   \
+    ".long 0x0, 0x0\n\t"                                                       \
+    ".quad 1f, (2f - 1f), 4f\n\t"                                              \
+    ".popsection\n\t"                                                          \
+    "leaq 3b(%%rip), %%rax\n\t"                                                \
+    "movq %%rax, 8(%[rseq])\n\t"                                               \
+    "1:\n\t"
+
+#define RSEQ_CS_END                                                            \
+    "2:\n\t"                                                                   \
+    ".pushsection __rseq_failure, \"ax\"\n\t"                                  \
+    ".byte 0x0f, 0xb9, 0x3d\n\t"                                               \
+    ".long " STRINGIFY(RSEQ_SIG) "\n\t"                                        \
+    "4:\n\t"                                                                   \
+    "jmp %l[abort]\n\t"                                                        \
+    ".popsection\n\t"
+
+static percpu_cache *caches;
+static uint64_t num_cpus;
+static pthread_once_t caches_once = PTHREAD_ONCE_INIT;
+
+static void init_caches(void) {
+    if (__rseq_size < 20)
+        return;
+    long n = get_nprocs_conf();
+    percpu_cache *c = mmap(NULL, n * sizeof(percpu_cache),
+                           PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                           -1, 0);
+    if (c == MAP_FAILED)
+        return;
+    num_cpus = n;
+    caches = c;
+}
+
+static struct rseq *thread_rseq(void) {
+    return (struct rseq *)((char *)__builtin_thread_pointer() + __rseq_offset);
+}
+
+// NULL if rseq isn't usable on this thread
+static struct rseq *get_rseq(void) {
+    pthread_once(&caches_once, init_caches);
+    if (caches == NULL)
+        return NULL;
+    struct rseq *rs = thread_rseq();
+    if ((int32_t)rs->cpu_id < 0 || rs->cpu_id >= num_cpus)
+        return NULL;
+    return rs;
+}
+
+// the chunk on top of this CPU's bin, NULL if it is empty. the result is
+// stored through a pointer after the commit rather than being an asm output,
+// gcc doesn't always keep asm goto outputs straight once this is inlined
+static void *percpu_pop(struct rseq *rs, size_t bucket) {
+    percpu_bin *bin = &caches[0].bins[bucket];
+    uint64_t stride = sizeof(percpu_cache);
+    void *res;
+retry:
+    __asm__ __volatile__ goto(RSEQ_CS_START
+                              "movl 4(%[rseq]), %%eax\n\t"
+                              "imulq %[stride], %%rax\n\t"
+                              "addq %[bin], %%rax\n\t"
+                              "xorl %%r11d, %%r11d\n\t"
+                              "movq (%%rax), %%rcx\n\t"
+                              "testq %%rcx, %%rcx\n\t"
+                              "jz 2f\n\t"
+                              "movq (%%rax, %%rcx, 8), %%r11\n\t"
+                              "decq %%rcx\n\t"
+                              // commit
+                              "movq %%rcx, (%%rax)\n\t" RSEQ_CS_END
+                              "movq %%r11, (%[res])\n\t"
+                              :
+                              : [rseq] "r"(rs), [stride] "r"(stride),
+                                [bin] "r"(bin), [res] "r"(&res)
+                              : "memory", "cc", "rax", "rcx", "r11"
+                              : abort);
+    return res;
+abort:
+    goto retry;
+}
+
+// false if this CPU's bin is full
+static bool percpu_push(struct rseq *rs, size_t bucket, void *p) {
+    percpu_bin *bin = &caches[0].bins[bucket];
+    uint64_t stride = sizeof(percpu_cache);
+retry:
+    __asm__ __volatile__ goto(RSEQ_CS_START
+                              "movl 4(%[rseq]), %%eax\n\t"
+                              "imulq %[stride], %%rax\n\t"
+                              "addq %[bin], %%rax\n\t"
+                              "movq (%%rax), %%rcx\n\t"
+                              "cmpq %[slots], %%rcx\n\t"
+                              "jae %l[full]\n\t"
+                              "movq %[p], 8(%%rax, %%rcx, 8)\n\t"
+                              "incq %%rcx\n\t"
+                              // commit
+                              "movq %%rcx, (%%rax)\n\t" RSEQ_CS_END
+                              :
+                              : [rseq] "r"(rs), [stride] "r"(stride),
+                                [bin] "r"(bin), [p] "r"(p),
+                                [slots] "i"(PERCPU_SLOTS)
+                              : "memory", "cc", "rax", "rcx"
+                              : full, abort);
+    return true;
+full:
+    return false;
+abort:
+    goto retry;
+}
+
+bool percpu_available(void) { return get_rseq() != NULL; }
+
+void *percpu_allo_cate(allocator *a, size_t to_alloc) {
+    struct rseq *rs = get_rseq();
+    if (rs == NULL)
+        return NULL;
+
+    size_t bucket = get_arena_bucket(to_alloc);
+    arena_free_chunk *c = percpu_pop(rs, bucket);
+    if (c == NULL) {
+        allo_cate_arena_list(a, to_alloc, PERCPU_BATCH, &c);
+        if (c == NULL)
+            return NULL;
+
+        // keep the first and cache the rest, we may have migrated CPUs
+        // meanwhile which only means refilling another CPU's bin
+        arena_free_chunk *rest = c->next;
+        while (rest != NULL) {
+            arena_free_chunk *next = rest->next;
+            if (!percpu_push(rs, bucket, rest)) {
+                size_t n = 1;
+                arena_free_chunk *tail = rest;
+                for (; tail->next != NULL; n++)
+                    tail = tail->next;
+                allo_free_arena_list(a, bucket, rest, tail, n);
+                break;
+            }
+            rest = next;
+        }
+    }
+
+    return c;
+}
+
+bool percpu_free(allocator *a, void *p, uint64_t bucket) {
+    struct rseq *rs = get_rseq();
+    if (rs == NULL)
+        return false;
+
+    if (percpu_push(rs, bucket, p))
+        return true;
+
+    // full, move p and half the bin back as one batch
+    arena_free_chunk *head = p;
+    arena_free_chunk *tail = head;
+    size_t n = 1;
+    for (; n < PERCPU_BATCH; n++) {
+        arena_free_chunk *c = percpu_pop(rs, bucket);
+        if (c == NULL)
+            break;
+        c->next = head;
+        head = c;
+    }
+    allo_free_arena_list(a, bucket, head, tail, n);
+    return true;
+}
+
+#else
+
+bool percpu_available(void) { return false; }
+
+void *percpu_allo_cate(allocator *a, size_t to_alloc) {
+    (void)a;
+    (void)to_alloc;
+    return NULL;
+}
+
+bool percpu_free(allocator *a, void *p, uint64_t bucket) {
+    (void)a;
+    (void)p;
+    (void)bucket;
+    return false;
+}
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef PERCPU_H
+#define PERCPU_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "allo.h"
+
+// Per-CPU caches in front of the arena buckets of the global allocator, built
+// on Linux restartable sequences. Popping or pushing a cached chunk is a short
+// rseq critical section on the current CPU's bin with no atomics, and the
+// memory held in the caches is bounded by the number of CPUs rather than the
+// number of threads.
+//
+// Everything returns NULL/false when rseq isn't registered for the calling
+// thread (old kernel or glibc, or glibc.pthread.rseq=0), and the caller falls
+// back to the normal path.
+
+#define PERCPU_BATCH TRANSFER_BATCH
+// chunks cached per CPU per bucket
+#define PERCPU_SLOTS (2 * PERCPU_BATCH)
+
+typedef struct percpu_bin {
+    // written only from rseq critical sections on the owning CPU
+    uint64_t count;
+    void *slots[PERCPU_SLOTS];
+} percpu_bin;
+
+typedef struct percpu_cache {
+    percpu_bin bins[NUM_ARENA_BUCKETS];
+} percpu_cache;
+
+bool percpu_available(void);
+// to_alloc must already be rounded to an arena size
+void *percpu_allo_cate(allocator *a, size_t to_alloc);
+// p must be a slab object of a in the given arena bucket, false if it wasn't
+// taken
+bool percpu_free(allocator *a, void *p, uint64_t bucket);
+
+#endif
@@ -0,0 +1,104 @@
+#include "persistent.h"
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "allo.h"
+#include "pagemap.h"
+
+_Static_assert(sizeof(allo_persistent) <= HEAP_SIZE,
+               "the persistent header must fit before the first heap");
+_Static_assert(ALLO_PERSISTENT_BASE % HEAP_SIZE == 0,
+               "heaps in a persistent file must stay HEAP_SIZE aligned");
+
+static allo_persistent *map_at(int fd, uint64_t base, uint64_t size) {
+    void *p = mmap((void *)base, size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_FIXED_NOREPLACE, fd, 0);
+    if (p == MAP_FAILED)
+        return NULL;
+    // kernels before 4.17 take the address as a hint
+    if (p != (void *)base) {
+        munmap(p, size);
+        return NULL;
+    }
+    return p;
+}
+
+static allo_persistent *create(int fd, size_t size) {
+    size = (size + HEAP_SIZE - 1) & ~(size_t)(HEAP_SIZE - 1);
+    if (size < 2 * HEAP_SIZE)
+        size = 2 * HEAP_SIZE;
+    if (ftruncate(fd, size) != 0)
+        return NULL;
+    allo_persistent *p = map_at(fd, ALLO_PERSISTENT_BASE, size);
+    if (p == NULL)
+        return NULL;
+
+    p->allocator_size = sizeof(allocator);
+    p->heap_size = HEAP_SIZE;
+    p->base = ALLO_PERSISTENT_BASE;
+    p->size = size;
+    p->top = HEAP_SIZE;
+    p->root = NULL;
+    initialize_allocator(&p->allocator);
+    p->allocator.backing = p;
+    // last, so a half made file isn't taken for a heap
+    p->magic = ALLO_PERSISTENT_MAGIC;
+    return p;
+}
+
+static allo_persistent *reopen(int fd, size_t file_size) {
+    allo_persistent header;
+    if (pread(fd, &header, sizeof(header), 0) != sizeof(header)
+        || header.magic != ALLO_PERSISTENT_MAGIC
+        || header.allocator_size != sizeof(allocator)
+        || header.heap_size != HEAP_SIZE || header.size != file_size)
+        return NULL;
+
+    allo_persistent *p = map_at(fd, header.base, header.size);
+    if (p == NULL)
+        return NULL;
+    if (!allo_reattach(&p->allocator)) {
+        pagemap_clear(p, p->size);
+        munmap(p, p->size);
+        return NULL;
+    }
+    return p;
+}
+
+allocator *allo_open_persistent(const char *path, size_t size) {
+    int fd = open(path, O_RDWR | O_CREAT, 0600);
+    if (fd < 0)
+        return NULL;
+    struct stat st;
+    allo_persistent *p = NULL;
+    if (fstat(fd, &st) == 0)
+        p = st.st_size == 0 ? create(fd, size) : reopen(fd, st.st_size);
+    // the mapping keeps the file open
+    close(fd);
+    return p == NULL ? NULL : &p->allocator;
+}
+
+void **allo_persistent_root(allocator *a) { return &a->backing->root; }
+
+void allo_close_persistent(allocator *a) {
+    allo_persistent *p = a->backing;
+    pagemap_clear(p, p->size);
+    munmap(p, p->size);
+}
+
+void *persistent_span(allo_persistent *p, size_t size, size_t align) {
+    uint64_t top = __atomic_load_n(&p->top, __ATOMIC_RELAXED);
+    uint64_t start;
+    do {
+        start = (top + align - 1) & ~(align - 1);
+        if (start + size > p->size)
+            return NULL;
+    } while (!__atomic_compare_exchange_n(&p->top, &top, start + size, true,
+                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    return (char *)p + start;
+}
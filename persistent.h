@@ -0,0 +1,54 @@
+#ifndef PERSISTENT_H
+#define PERSISTENT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "allo.h"
+
+// An allocator living in a file mapped MAP_SHARED at a fixed address, so the
+// pointers in it (allocator metadata and user data alike) are still valid
+// when the file is mapped again by a later process. Reopening only rebuilds
+// the process wide page map, nothing in the file is rewritten.
+//
+// The file starts with a header holding the allocator itself. Heaps, slab
+// heaps and mmapped chunks are then carved off the rest of the file in
+// order and never given back: the mmap cache keeps freed large chunks
+// regardless of its budget, and decay and allo_trim do nothing.
+//
+// Only one persistent heap can be mapped at a time, since they all live at
+// ALLO_PERSISTENT_BASE. Object caches store function pointers, so they
+// shouldn't be kept across processes.
+
+// below PIE executables and shared libraries, and clear of the ranges ASan
+// reserves for its shadow and its own allocator
+#define ALLO_PERSISTENT_BASE 0x520000000000ull
+#define ALLO_PERSISTENT_MAGIC 0x616c6c6f70657273ull
+
+typedef struct allo_persistent {
+    uint64_t magic;
+    // layout of the allocator that made the file, so a different build
+    // refuses it
+    uint64_t allocator_size;
+    uint64_t heap_size;
+    uint64_t base;
+    uint64_t size;
+    // offset of the first byte not carved off yet
+    uint64_t top;
+    void *root;
+    allocator allocator;
+} allo_persistent;
+
+// map the persistent heap at path, creating it with room for size bytes if
+// the file is empty or missing. NULL if the file isn't a persistent heap of
+// this build or can't be mapped at its address
+allocator *allo_open_persistent(const char *path, size_t size);
+// where to keep a pointer to the user's data, so it can be found again
+void **allo_persistent_root(allocator *a);
+// unmap the heap, everything in it stays in the file
+void allo_close_persistent(allocator *a);
+
+// size bytes of the file at an align aligned address, NULL if it is full
+void *persistent_span(allo_persistent *p, size_t size, size_t align);
+
+#endif
@@ -0,0 +1,111 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "allo.h"
+
+// The libc malloc family on top of global_allocator, for liballo.so. Only
+// the names below and the allo API are exported (see liballo.map), so the
+// allocator's internals can't be interposed by the program.
+
+// the names are the real ones here
+#undef malloc
+#undef free
+#undef calloc
+#undef realloc
+#undef posix_memalign
+#undef aligned_alloc
+#undef memalign
+#undef free_sized
+#undef free_aligned_sized
+
+void *malloc(size_t size) {
+    void *p = _allo_malloc(size);
+    if (p == NULL)
+        errno = ENOMEM;
+    return p;
+}
+
+void free(void *p) { _allo_free(p); }
+
+void *calloc(size_t nmemb, size_t size) {
+    void *p = _allo_calloc(nmemb, size);
+    if (p == NULL)
+        errno = ENOMEM;
+    return p;
+}
+
+void *realloc(void *p, size_t size) {
+    void *res = _allo_realloc(p, size);
+    if (res == NULL)
+        errno = ENOMEM;
+    return res;
+}
+
+void *reallocarray(void *p, size_t nmemb, size_t size) {
+    size_t n;
+    if (__builtin_mul_overflow(nmemb, size, &n)) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    return realloc(p, n);
+}
+
+int posix_memalign(void **memptr, size_t align, size_t size) {
+    return _allo_posix_memalign(memptr, align, size);
+}
+
+void *aligned_alloc(size_t align, size_t size) {
+    return _allo_aligned_alloc(align, size);
+}
+
+void *memalign(size_t align, size_t size) {
+    return _allo_memalign(align, size);
+}
+
+void *valloc(size_t size) { return _allo_aligned(PAGE_SIZE, size); }
+
+void *pvalloc(size_t size) {
+    return _allo_aligned(PAGE_SIZE, (size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1));
+}
+
+size_t malloc_usable_size(void *p) {
+    return p == NULL ? 0 : introspect_size(p);
+}
+
+void free_sized(void *p, size_t size) { _allo_free_sized(p, size); }
+
+void free_aligned_sized(void *p, size_t align, size_t size) {
+    _allo_free_aligned_sized(p, align, size);
+}
+
+int malloc_trim(size_t pad) { return allo_trim(&global_allocator, pad) > 0; }
+
+// a fork while another thread holds one of the global allocator's locks
+// would leave it locked forever in the child. the order is the allocator's
+// own: arenas, then transfer caches, then heaps, then mmapped chunks
+static void lock_all(void) {
+    allocator *a = &global_allocator;
+    for (size_t i = 0; i < NUM_ARENA_BUCKETS; i++)
+        LOCK(a->arenas[i].lock);
+    for (size_t i = 0; i < NUM_ARENA_BUCKETS; i++)
+        LOCK(a->transfer_caches[i].lock);
+    LOCK(a->heap_lock);
+    LOCK(a->mmap_lock);
+}
+
+static void unlock_all(void) {
+    allocator *a = &global_allocator;
+    UNLOCK(a->mmap_lock);
+    UNLOCK(a->heap_lock);
+    for (size_t i = 0; i < NUM_ARENA_BUCKETS; i++)
+        UNLOCK(a->transfer_caches[i].lock);
+    for (size_t i = 0; i < NUM_ARENA_BUCKETS; i++)
+        UNLOCK(a->arenas[i].lock);
+}
+
+__attribute__((constructor)) static void register_fork_handlers(void) {
+    pthread_atfork(lock_all, unlock_all, unlock_all);
+}
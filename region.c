@@ -0,0 +1,93 @@
+#include "region.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "allo.h"
+
+#define REGION_ALIGN 16
+
+static char *align_up(char *p) {
+    return (char *)(((uint64_t)p + REGION_ALIGN - 1) & ~(uint64_t)(REGION_ALIGN - 1));
+}
+
+void allo_region_init(allo_region *r, allocator *a, size_t block_size) {
+    r->a = a;
+    r->block_size = block_size == 0 ? ALLO_REGION_BLOCK_SIZE : block_size;
+    r->blocks = NULL;
+    r->current = NULL;
+    r->top = NULL;
+}
+
+// first spare after the current block with room for size bytes, or a new
+// block linked in after the current one
+static region_block *next_block(allo_region *r, size_t size) {
+    region_block **link = r->current == NULL ? &r->blocks : &r->current->next;
+    for (region_block *b = *link; b != NULL; b = b->next) {
+        if ((size_t)(b->end - align_up(b->data)) >= size) {
+            // move b to right after the current block
+            region_block **prev = link;
+            while (*prev != b)
+                prev = &(*prev)->next;
+            *prev = b->next;
+            b->next = *link;
+            *link = b;
+            return b;
+        }
+    }
+
+    size_t to_alloc = sizeof(region_block) + REGION_ALIGN + size;
+    if (to_alloc < r->block_size)
+        to_alloc = r->block_size;
+    region_block *b = allo_cate(r->a, to_alloc);
+    if (b == NULL)
+        return NULL;
+    b->end = (char *)b + introspect_size(b);
+    b->next = *link;
+    *link = b;
+    return b;
+}
+
+void *allo_region_cate(allo_region *r, size_t size) {
+    if (size > SIZE_MAX / 2)
+        return NULL;
+    size = (size + REGION_ALIGN - 1) & ~(size_t)(REGION_ALIGN - 1);
+    if (r->current != NULL && (size_t)(r->current->end - r->top) >= size) {
+        void *res = r->top;
+        r->top += size;
+        return res;
+    }
+
+    region_block *b = next_block(r, size);
+    if (b == NULL)
+        return NULL;
+    r->current = b;
+    char *res = align_up(b->data);
+    r->top = res + size;
+    return res;
+}
+
+allo_region_mark allo_region_save(allo_region *r) {
+    return (allo_region_mark){.block = r->current, .top = r->top};
+}
+
+void allo_region_restore(allo_region *r, allo_region_mark mark) {
+    r->current = mark.block;
+    r->top = mark.top;
+}
+
+void allo_region_reset(allo_region *r) {
+    r->current = NULL;
+    r->top = NULL;
+}
+
+void allo_region_destroy(allo_region *r) {
+    region_block *next;
+    for (region_block *b = r->blocks; b != NULL; b = next) {
+        next = b->next;
+        allo_free(r->a, b);
+    }
+    r->blocks = NULL;
+    r->current = NULL;
+    r->top = NULL;
+}
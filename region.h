@@ -0,0 +1,53 @@
+#ifndef REGION_H
+#define REGION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "allo.h"
+
+// Bump allocator over blocks taken from an allocator, for allocations that
+// all die together. Nothing is freed on its own: allo_region_reset frees
+// everything at once and keeps the blocks for the next round, and
+// allo_region_restore frees everything allocated since a mark.
+//
+// Blocks are kept in the order they were first used. Those past the current
+// block are spares, left over from a reset or restore.
+
+// default size of a block including its header
+#define ALLO_REGION_BLOCK_SIZE (HEAP_SIZE / 4)
+
+typedef struct region_block {
+    struct region_block *next;
+    char *end;
+    char data[];
+} region_block;
+
+typedef struct allo_region {
+    allocator *a;
+    size_t block_size;
+    region_block *blocks;
+    // NULL until the first allocation after init, reset or a restore to the
+    // start
+    region_block *current;
+    char *top;
+} allo_region;
+
+// everything allocated after a mark is freed by restoring it. marks nest:
+// restoring a mark invalidates the ones taken after it
+typedef struct allo_region_mark {
+    region_block *block;
+    char *top;
+} allo_region_mark;
+
+// block_size 0 for ALLO_REGION_BLOCK_SIZE
+void allo_region_init(allo_region *r, allocator *a, size_t block_size);
+// 16 byte aligned, NULL if the allocator is out of memory
+void *allo_region_cate(allo_region *r, size_t size);
+allo_region_mark allo_region_save(allo_region *r);
+void allo_region_restore(allo_region *r, allo_region_mark mark);
+void allo_region_reset(allo_region *r);
+// give every block back to the allocator
+void allo_region_destroy(allo_region *r);
+
+#endif
@@ -3,4 +3,11 @@
 void initialize_stats(stats *s) {
     s->num_bytes_allocated = 0;
     s->total_heap_size     = 0;
+    s->mmap_cache_hits     = 0;
+    s->mmap_cache_misses   = 0;
+    s->mmap_cache_bytes    = 0;
+    s->purged_bytes        = 0;
+    s->calloc_cleared_bytes = 0;
+    s->numa_local_allocations  = 0;
+    s->numa_remote_allocations = 0;
 }
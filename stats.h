@@ -6,8 +6,27 @@
 typedef struct stats {
     uint64_t num_bytes_allocated;
     uint64_t total_heap_size;
+    // mmapped chunk allocations served from / missing the mmap cache, and the
+    // bytes it holds
+    uint64_t mmap_cache_hits;
+    uint64_t mmap_cache_misses;
+    uint64_t mmap_cache_bytes;
+    // bytes given back to the OS by decay and allo_trim
+    uint64_t purged_bytes;
+    // bytes allo_calloc and the zero pool had to clear, not being known to
+    // be zero already. small calloc through the caches without the pool
+    // always clears and isn't counted
+    uint64_t calloc_cleared_bytes;
+    // allo_cate_on_node calls for this allocator's node from a CPU on it /
+    // on another node, see numa.h
+    uint64_t numa_local_allocations;
+    uint64_t numa_remote_allocations;
 } stats;
 
+// the fields are updated under different locks
+#define STATS_ADD(field, n) __atomic_fetch_add(&(field), (n), __ATOMIC_RELAXED)
+#define STATS_SUB(field, n) __atomic_fetch_sub(&(field), (n), __ATOMIC_RELAXED)
+
 void initialize_stats(stats *s);
 
 #endif
@@ -0,0 +1,150 @@
+#include "tcache.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "allo.h"
+
+static __thread tcache thread_cache;
+
+static pthread_key_t tcache_key;
+static pthread_once_t tcache_key_once = PTHREAD_ONCE_INIT;
+
+static void tcache_thread_exit(void *arg) {
+    (void)arg;
+    tcache_drain();
+    thread_cache.state = TCACHE_DRAINED;
+}
+
+static void tcache_make_key(void) {
+    pthread_key_create(&tcache_key, tcache_thread_exit);
+}
+
+// returns NULL if the calling thread can no longer cache for a
+static tcache *get_tcache(allocator *a) {
+    tcache *tc = &thread_cache;
+    if (tc->state == TCACHE_ACTIVE)
+        return tc->owner == a ? tc : NULL;
+    if (tc->state == TCACHE_DRAINED)
+        return NULL;
+
+    pthread_once(&tcache_key_once, tcache_make_key);
+    // any non NULL value, only there so the destructor runs
+    pthread_setspecific(tcache_key, tc);
+    tc->owner = a;
+    tc->state = TCACHE_ACTIVE;
+    return tc;
+}
+
+static void tcache_refill(allocator *a, tcache_bin *bin, size_t to_alloc) {
+    bin->count = allo_cate_arena_list(a, to_alloc, TCACHE_BATCH, &bin->head);
+}
+
+// hand the n chunks at the top of the bin back to the arena
+static void tcache_flush(allocator *a, tcache_bin *bin, uint64_t bucket,
+                         uint32_t n) {
+    arena_free_chunk *head = bin->head;
+    arena_free_chunk *tail = head;
+    for (uint32_t i = 1; i < n; i++)
+        tail = tail->next;
+    bin->head = tail->next;
+    bin->count -= n;
+
+    allo_free_arena_list(a, bucket, head, tail, n);
+}
+
+void *tcache_allo_cate(allocator *a, size_t to_alloc) {
+    tcache *tc = get_tcache(a);
+    if (tc == NULL)
+        return allo_cate(a, to_alloc);
+
+    tcache_bin *bin = &tc->bins[get_arena_bucket(to_alloc)];
+    if (bin->head == NULL) {
+        tcache_refill(a, bin, to_alloc);
+        if (bin->head == NULL)
+            return NULL;
+    }
+
+    arena_free_chunk *c = bin->head;
+    bin->head = c->next;
+    bin->count--;
+    return c;
+}
+
+#ifdef ALLO_ZERO_POOL
+void *tcache_allo_cate_zeroed(allocator *a, size_t to_alloc) {
+    tcache *tc = get_tcache(a);
+    if (tc == NULL)
+        return allo_calloc(a, 1, to_alloc);
+
+    tcache_bin *bin = &tc->zeroed[get_arena_bucket(to_alloc)];
+    if (bin->head == NULL) {
+        bin->count =
+            allo_cate_arena_zeroed_list(a, to_alloc, TCACHE_BATCH, &bin->head);
+    }
+    if (bin->head == NULL) {
+        // only used memory left, which has to be cleared after all
+        tcache_refill(a, bin, to_alloc);
+        if (bin->head == NULL)
+            return NULL;
+        for (arena_free_chunk *c = bin->head; c != NULL; c = c->next)
+            memset(c + 1, 0, to_alloc - sizeof(arena_free_chunk));
+        STATS_ADD(a->stats.calloc_cleared_bytes,
+                  bin->count * (to_alloc - sizeof(arena_free_chunk)));
+    }
+
+    arena_free_chunk *c = bin->head;
+    bin->head = c->next;
+    bin->count--;
+    c->next = NULL;
+    return c;
+}
+#endif
+
+void tcache_free(allocator *a, void *p, uint64_t bucket) {
+    tcache *tc = get_tcache(a);
+    if (tc == NULL) {
+        allo_free(a, p);
+        return;
+    }
+
+    tcache_bin *bin = &tc->bins[bucket];
+    if (bin->count == TCACHE_MAX_COUNT)
+        tcache_flush(a, bin, bucket, TCACHE_BATCH);
+
+    arena_free_chunk *c = p;
+    c->next = bin->head;
+    bin->head = c;
+    bin->count++;
+}
+
+void tcache_drain(void) {
+    tcache *tc = &thread_cache;
+    if (tc->state != TCACHE_ACTIVE)
+        return;
+    for (size_t i = 0; i < NUM_ARENA_BUCKETS; i++) {
+        if (tc->bins[i].count > 0)
+            tcache_flush(tc->owner, &tc->bins[i], i, tc->bins[i].count);
+#ifdef ALLO_ZERO_POOL
+        if (tc->zeroed[i].count > 0)
+            tcache_flush(tc->owner, &tc->zeroed[i], i, tc->zeroed[i].count);
+#endif
+    }
+}
+
+void tcache_discard(allocator *a) {
+    tcache *tc = &thread_cache;
+    if (tc->state != TCACHE_ACTIVE || tc->owner != a)
+        return;
+    for (size_t i = 0; i < NUM_ARENA_BUCKETS; i++) {
+        tc->bins[i].head = NULL;
+        tc->bins[i].count = 0;
+#ifdef ALLO_ZERO_POOL
+        tc->zeroed[i].head = NULL;
+        tc->zeroed[i].count = 0;
+#endif
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef TCACHE_H
+#define TCACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "allo.h"
+
+// Thread-local caches sitting in front of the arena buckets of the global
+// allocator. Each bucket is a bounded stack of free chunks, refilled from and
+// flushed to the allocator's transfer caches in batches of TCACHE_BATCH.
+//
+// With ALLO_ZERO_POOL each bucket also has a pool of objects that are zero
+// apart from their link, so calloc only has to clear the link. The pool is
+// refilled from slab memory that was never handed out since it was mapped
+// or purged, and only zeroed by hand when the arena has none of that left.
+
+#define TCACHE_BATCH TRANSFER_BATCH
+// most chunks a thread keeps per bucket before flushing half of them
+#define TCACHE_MAX_COUNT (2 * TCACHE_BATCH)
+
+enum tcache_state {
+    TCACHE_UNINITIALIZED = 0,
+    TCACHE_ACTIVE,
+    // thread is exiting, everything goes straight to the shared arenas
+    TCACHE_DRAINED,
+};
+
+typedef struct tcache_bin {
+    arena_free_chunk *head;
+    uint32_t count;
+} tcache_bin;
+
+typedef struct tcache {
+    enum tcache_state state;
+    allocator *owner;
+    tcache_bin bins[NUM_ARENA_BUCKETS];
+#ifdef ALLO_ZERO_POOL
+    tcache_bin zeroed[NUM_ARENA_BUCKETS];
+#endif
+} tcache;
+
+// to_alloc must already be rounded to an arena size
+void *tcache_allo_cate(allocator *a, size_t to_alloc);
+#ifdef ALLO_ZERO_POOL
+// the same, zeroed
+void *tcache_allo_cate_zeroed(allocator *a, size_t to_alloc);
+#endif
+// p must be a slab object of a in the given arena bucket
+void tcache_free(allocator *a, void *p, uint64_t bucket);
+// give every cached chunk of the calling thread back to its allocator
+void tcache_drain(void);
+// forget the calling thread's cached chunks without touching a
+// (used when a is torn down underneath the cache)
+void tcache_discard(allocator *a);
+
+#endif
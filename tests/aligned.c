@@ -0,0 +1,109 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "allo.h"
+#include "pagemap.h"
+
+allocator a;
+
+void check(void *p, size_t align, size_t size) {
+    assert(p != NULL);
+    assert(((uint64_t)p & (align - 1)) == 0);
+    assert(introspect_size(p) >= size);
+    assert(allo_owns(&a, p));
+    assert(allo_owns(&a, (char *)p + size - 1));
+    memset(p, 0xab, size);
+}
+
+void test_every_path(void) {
+    size_t sizes[] = {1, 24, 100, 700, 1024, 1500, 5000, 40000, 200000};
+    for (size_t align = 8; align <= (1 << 20); align *= 2) {
+        void *ps[sizeof(sizes) / sizeof(sizes[0])];
+        for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            ps[i] = allo_cate_aligned(&a, align, sizes[i]);
+            check(ps[i], align, sizes[i]);
+        }
+        for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+            allo_free(&a, ps[i]);
+    }
+}
+
+void test_natural_slab_alignment(void) {
+    // power of two sizes come from slabs, not from a bigger path
+    for (size_t align = 16; align <= MAX_ARENA_SIZE; align *= 2) {
+        void *p = allo_cate_aligned(&a, align, align);
+        check(p, align, align);
+        assert(PAGEMAP_KIND(pagemap_get(p)) == PAGE_SLAB);
+        allo_free(&a, p);
+    }
+}
+
+void test_medium_gaps_reused(void) {
+    uint64_t before = a.stats.num_bytes_allocated;
+    void *ps[64];
+    for (size_t i = 0; i < 64; i++) {
+        ps[i] = allo_cate_aligned(&a, 4096, 3000);
+        check(ps[i], 4096, 3000);
+        assert(PAGEMAP_KIND(pagemap_get(ps[i])) == PAGE_HEAP);
+    }
+    // the gaps went back, so the heaps are about as full as they can be
+    assert(a.stats.total_heap_size < 64 * 4096 * 2 + 4 * HEAP_SIZE);
+    for (size_t i = 0; i < 64; i++)
+        allo_free(&a, ps[i]);
+    assert(a.stats.num_bytes_allocated == before);
+}
+
+void test_realloc_aligned_mmapped(void) {
+    char *p = allo_cate_aligned(&a, 1 << 16, 300000);
+    check(p, 1 << 16, 300000);
+    for (size_t i = 0; i < 300000; i++)
+        p[i] = (char)i;
+    char *q = allo_realloc(&a, p, 600000);
+    for (size_t i = 0; i < 300000; i++)
+        assert(q[i] == (char)i);
+    allo_free(&a, q);
+}
+
+void test_libc(void) {
+    void *p = NULL;
+    assert(posix_memalign(&p, 3, 10) == EINVAL);
+    assert(posix_memalign(&p, 4, 10) == EINVAL);
+    assert(p == NULL);
+    assert(posix_memalign(&p, 64, 100) == 0);
+    assert(((uint64_t)p & 63) == 0);
+    free(p);
+
+    errno = 0;
+    assert(aligned_alloc(48, 96) == NULL);
+    assert(errno == EINVAL);
+    for (size_t align = 8; align <= (1 << 16); align *= 4) {
+        for (size_t size = 1; size < 500000; size = size * 5 + 3) {
+            char *q = aligned_alloc(align, size);
+            assert(((uint64_t)q & (align - 1)) == 0);
+            memset(q, 1, size);
+            q = realloc(q, size + 1);
+            assert(q[size - 1] == 1);
+            free(q);
+            q = memalign(align, size);
+            assert(((uint64_t)q & (align - 1)) == 0);
+            free(q);
+        }
+    }
+}
+
+int main(void) {
+    initialize_allocator(&a);
+
+    test_every_path();
+    test_natural_slab_alignment();
+    test_medium_gaps_reused();
+    test_realloc_aligned_mmapped();
+    test_libc();
+
+    free_allocator(&a);
+    printf("Test passed: aligned allocations were aligned on every path.\n");
+    return 0;
+}
@@ -0,0 +1,79 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "allo.h"
+
+#define N 5000
+
+allocator a;
+void *ptrs[N];
+
+void test_same_size(size_t size) {
+    uint64_t before = a.stats.num_bytes_allocated;
+    assert(allo_cate_batch(&a, size, ptrs, N) == N);
+    for (size_t i = 0; i < N; i++) {
+        assert(allo_owns(&a, ptrs[i]));
+        assert(introspect_size(ptrs[i]) >= size);
+        memset(ptrs[i], (int)i, size);
+    }
+    for (size_t i = 0; i < N; i++) {
+        for (size_t j = 0; j < size; j++)
+            assert(((unsigned char *)ptrs[i])[j] == (unsigned char)i);
+    }
+    allo_free_batch(&a, ptrs, N);
+    if (size > MAX_ARENA_SIZE)
+        assert(a.stats.num_bytes_allocated == before);
+}
+
+bool in(void **set, size_t n, void *p) {
+    for (size_t i = 0; i < n; i++) {
+        if (set[i] == p)
+            return true;
+    }
+    return false;
+}
+
+void test_mixed_free(void) {
+    size_t sizes[] = {8, 40, 200, 1000, 3000, 100000};
+    static void *forty[N / 6 + 1];
+    size_t num_forty = 0;
+    for (size_t i = 0; i < N; i++) {
+        ptrs[i] = allo_cate(&a, sizes[i % 6]);
+        if (sizes[i % 6] == 40)
+            forty[num_forty++] = ptrs[i];
+    }
+    ptrs[17] = NULL;
+    allo_free_batch(&a, ptrs, N);
+
+    // every 40 byte object made it back to its slab, leaving only the warm
+    // ones in the arena
+    arena *arena = &a.arenas[get_arena_bucket(40)];
+    for (slab *s = arena->partial_slabs; s != NULL; s = s->next)
+        assert(s->num_free == s->num_slots);
+    assert(arena->num_empty_slabs == ARENA_WARM_SLABS);
+
+    // so the same objects come out again
+    void *again[16];
+    assert(allo_cate_batch(&a, 40, again, 16) == 16);
+    for (size_t i = 0; i < 16; i++)
+        assert(in(forty, num_forty, again[i]));
+    allo_free_batch(&a, again, 16);
+}
+
+int main(void) {
+    initialize_allocator(&a);
+
+    test_same_size(16);
+    test_same_size(72);
+    test_same_size(1024);
+    test_same_size(5000);
+    test_mixed_free();
+    test_same_size(16);
+
+    free_allocator(&a);
+    printf("Test passed: batches were allocated and freed.\n");
+    return 0;
+}
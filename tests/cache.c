@@ -0,0 +1,112 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "allo.h"
+#include "cache.h"
+#include "pagemap.h"
+
+#define N 10000
+
+allocator a;
+
+typedef struct node {
+    uint64_t magic;
+    struct node *children[3];
+    char name[20];
+} node;
+
+size_t constructed = 0;
+size_t destructed = 0;
+
+void node_ctor(void *p) {
+    node *n = p;
+    n->magic = 0x600d;
+    memset(n->children, 0, sizeof(n->children));
+    strcpy(n->name, "fresh");
+    constructed++;
+}
+
+void node_dtor(void *p) {
+    assert(((node *)p)->magic == 0x600d);
+    destructed++;
+}
+
+node *nodes[N];
+
+void test_constructed_reuse(void) {
+    allo_cache *c = allo_cache_create(&a, sizeof(node), 0, node_ctor, node_dtor);
+    assert(c != NULL);
+    for (size_t i = 0; i < N; i++)
+        nodes[i] = allo_cache_get(c);
+    size_t first = constructed;
+    for (size_t round = 0; round < 20; round++) {
+        for (size_t i = round % 2; i < N; i += 2) {
+            // back to the constructed state before the put
+            nodes[i]->children[0] = NULL;
+            allo_cache_put(c, nodes[i]);
+        }
+        for (size_t i = round % 2; i < N; i += 2) {
+            nodes[i] = allo_cache_get(c);
+            assert(nodes[i]->magic == 0x600d);
+            assert(nodes[i]->children[0] == NULL);
+            assert(strcmp(nodes[i]->name, "fresh") == 0);
+            assert(introspect_size(nodes[i]) >= sizeof(node));
+            assert(allo_owns(&a, nodes[i]));
+            assert(PAGEMAP_KIND(pagemap_get(nodes[i])) == PAGE_CACHE);
+            nodes[i]->children[0] = nodes[i];
+        }
+    }
+    // churn reuses constructed objects
+    assert(constructed == first);
+    for (size_t i = 0; i < N; i++) {
+        nodes[i]->children[0] = NULL;
+        allo_cache_put(c, nodes[i]);
+    }
+    allo_cache_destroy(c);
+    assert(constructed == destructed);
+}
+
+void test_dense_slabs(void) {
+    // 40 bytes would be a 48 byte arena object
+    allo_cache *c = allo_cache_create(&a, 40, 0, NULL, NULL);
+    uint64_t before = a.stats.num_bytes_allocated;
+    for (size_t i = 0; i < N; i++)
+        nodes[i] = allo_cache_get(c);
+    uint64_t used = a.stats.num_bytes_allocated - before;
+    assert(used < N * 40 + N * 40 / 8 + SLAB_SIZE);
+    for (size_t i = 0; i < N; i++)
+        allo_cache_put(c, nodes[i]);
+    allo_cache_destroy(c);
+}
+
+void test_cache_line_aligned(void) {
+    allo_cache *c = allo_cache_create(&a, 24, ALLO_CACHE_LINE, NULL, NULL);
+    for (size_t i = 0; i < 1000; i++) {
+        nodes[i] = allo_cache_get(c);
+        assert(((uint64_t)nodes[i] & (ALLO_CACHE_LINE - 1)) == 0);
+    }
+    for (size_t i = 0; i < 1000; i++)
+        allo_cache_put(c, nodes[i]);
+    allo_cache_destroy(c);
+
+    assert(allo_cache_create(&a, ALLO_CACHE_MAX_SIZE + 1, 0, NULL, NULL)
+           == NULL);
+    assert(allo_cache_create(&a, 10, 24, NULL, NULL) == NULL);
+}
+
+int main(void) {
+    initialize_allocator(&a);
+
+    uint64_t before = a.stats.num_bytes_allocated;
+    test_constructed_reuse();
+    test_dense_slabs();
+    test_cache_line_aligned();
+    // every slab went back, only the cache structs' arena slab is left
+    assert(a.stats.num_bytes_allocated <= before + SLAB_SIZE);
+
+    free_allocator(&a);
+    printf("Test passed: object caches reused constructed objects.\n");
+    return 0;
+}
@@ -0,0 +1,143 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "allo.h"
+
+allocator a;
+
+void check_zero(char *p, size_t n) {
+    assert(p != NULL);
+    for (size_t i = 0; i < n; i++)
+        assert(p[i] == 0);
+}
+
+// pages of [p, p + n) the kernel has backed with memory
+size_t resident_pages(char *p, size_t n) {
+    char *start = (char *)((uint64_t)p & ~(PAGE_SIZE - 1));
+    size_t pages = (p + n - start + PAGE_SIZE - 1) / PAGE_SIZE;
+    static unsigned char vec[4096];
+    assert(pages <= sizeof(vec));
+    assert(mincore(start, pages * PAGE_SIZE, vec) == 0);
+    size_t resident = 0;
+    for (size_t i = 0; i < pages; i++)
+        resident += vec[i] & 1;
+    return resident;
+}
+
+// memory no one has used yet is handed out as is, only slab objects' links
+// get cleared
+void test_fresh_memory_not_cleared(void) {
+    static char *objects[1000];
+    uint64_t cleared = a.stats.calloc_cleared_bytes;
+    for (size_t i = 0; i < 1000; i++)
+        objects[i] = allo_calloc(&a, 1, 200);
+    assert(a.stats.calloc_cleared_bytes - cleared
+           <= 1000 * sizeof(arena_free_chunk));
+    for (size_t i = 0; i < 1000; i++) {
+        check_zero(objects[i], 200);
+        allo_free(&a, objects[i]);
+    }
+
+    cleared = a.stats.calloc_cleared_bytes;
+    char *medium = allo_calloc(&a, 1, 100000);
+    char *big = allo_calloc(&a, 1, 8 << 20);
+    assert(a.stats.calloc_cleared_bytes == cleared);
+    // at most the pages with headers in them were touched
+    assert(resident_pages(medium, 100000) <= 2);
+    assert(resident_pages(big, 8 << 20) <= 2);
+    check_zero(medium, 100000);
+    check_zero(big, 8 << 20);
+    allo_free(&a, medium);
+    allo_free(&a, big);
+
+    // the same through calloc, which only skips clearing small objects from
+    // the zero pool
+    cleared = global_allocator.stats.calloc_cleared_bytes;
+    for (size_t i = 0; i < 1000; i++)
+        objects[i] = calloc(1, 200);
+#ifdef ALLO_ZERO_POOL
+    assert(global_allocator.stats.calloc_cleared_bytes - cleared
+           <= 1000 * sizeof(arena_free_chunk));
+#endif
+    for (size_t i = 0; i < 1000; i++) {
+        check_zero(objects[i], 200);
+        free(objects[i]);
+    }
+}
+
+// dirty memory of every path, then calloc the same sizes again
+void test_reused_memory_cleared(void) {
+    size_t sizes[] = {8, 100, 1000, 3000, 20000, 60000, 300000};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        size_t n = sizes[i];
+        char *p = allo_calloc(&a, 1, n);
+        check_zero(p, n);
+        memset(p, 0xff, n);
+        allo_free(&a, p);
+
+        char *q = allo_calloc(&a, n / 4, 4);
+        check_zero(q, n);
+        memset(q, 0xff, n);
+        allo_free(&a, q);
+    }
+}
+
+void test_grown_then_freed(void) {
+    // dirty the untouched part of a heap through realloc
+    char *p = allo_cate(&a, 2000);
+    p = allo_realloc(&a, p, 30000);
+    memset(p, 0xee, 30000);
+    allo_free(&a, p);
+    char *q = allo_calloc(&a, 1, 30000);
+    check_zero(q, 30000);
+    allo_free(&a, q);
+}
+
+void test_purged_memory_cleared(void) {
+    char *p = allo_cate(&a, 40000);
+    char *blocker = allo_cate(&a, 2000);
+    memset(p, 0xff, 40000);
+    allo_free(&a, p);
+    allo_trim(&a, 0);
+    char *q = allo_calloc(&a, 1, 40000);
+    check_zero(q, 40000);
+    allo_free(&a, q);
+    allo_free(&a, blocker);
+}
+
+void test_overflow(void) {
+    assert(allo_calloc(&a, SIZE_MAX / 2, 3) == NULL);
+    assert(calloc(SIZE_MAX / 2, 3) == NULL);
+    assert(calloc((size_t)1 << 33, (size_t)1 << 33) == NULL);
+}
+
+void test_malloc_calloc(void) {
+    for (size_t n = 1; n < 100000; n = n * 3 + 1) {
+        char *ps[16];
+        for (size_t i = 0; i < 16; i++) {
+            ps[i] = calloc(n, 1);
+            check_zero(ps[i], n);
+            memset(ps[i], 0xff, n);
+        }
+        for (size_t i = 0; i < 16; i++)
+            free(ps[i]);
+    }
+}
+
+int main(void) {
+    initialize_allocator(&a);
+
+    test_fresh_memory_not_cleared();
+    test_reused_memory_cleared();
+    test_grown_then_freed();
+    test_purged_memory_cleared();
+    test_overflow();
+    test_malloc_calloc();
+
+    free_allocator(&a);
+    printf("Test passed: calloc memory was always zero.\n");
+    return 0;
+}
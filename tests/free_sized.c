@@ -0,0 +1,65 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "allo.h"
+
+allocator a;
+
+size_t sizes[] = {1, 8, 17, 128, 129, 1000, 1024, 1025, 5000, 60000, 300000};
+#define NUM_SIZES (sizeof(sizes) / sizeof(sizes[0]))
+
+void test_every_path(void) {
+    uint64_t before = a.stats.num_bytes_allocated;
+    for (size_t round = 0; round < 100; round++) {
+        void *ps[NUM_SIZES];
+        for (size_t i = 0; i < NUM_SIZES; i++) {
+            ps[i] = allo_cate(&a, sizes[i]);
+            memset(ps[i], 1, sizes[i]);
+        }
+        for (size_t i = 0; i < NUM_SIZES; i++)
+            allo_free_sized(&a, ps[i], sizes[i]);
+    }
+    // only warm slabs are left
+    assert(a.stats.num_bytes_allocated - before <= NUM_ARENA_BUCKETS * SLAB_SIZE);
+
+    // the same objects come back, so they went to the right place
+    void *p = allo_cate(&a, 40);
+    allo_free_sized(&a, p, 40);
+    assert(allo_cate(&a, 33) == p);
+    allo_free_sized(&a, p, 33);
+}
+
+void test_after_realloc(void) {
+    char *p = allo_cate(&a, 2000);
+    p = allo_realloc(&a, p, 20000);
+    allo_free_sized(&a, p, 20000);
+    p = allo_cate(&a, 100);
+    p = allo_realloc(&a, p, 300000);
+    allo_free_sized(&a, p, 300000);
+    p = allo_calloc(&a, 3, 30);
+    allo_free_sized(&a, p, 90);
+}
+
+void test_libc(void) {
+    for (size_t i = 0; i < NUM_SIZES; i++) {
+        void *p = malloc(sizes[i]);
+        free_sized(p, sizes[i]);
+        p = aligned_alloc(256, sizes[i]);
+        free_aligned_sized(p, 256, sizes[i]);
+    }
+    free_sized(NULL, 10);
+}
+
+int main(void) {
+    initialize_allocator(&a);
+
+    test_every_path();
+    test_after_realloc();
+    test_libc();
+
+    free_allocator(&a);
+    printf("Test passed: sized frees found their way back.\n");
+    return 0;
+}
@@ -0,0 +1,47 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "allo.h"
+
+#define CHUNK_BYTES 30000
+#define NUM_OPS 200000
+
+// medium allo_free + allo_cate latency as the number of heaps grows, every
+// free coalesces with its neighbours which used to walk the heap list
+allocator a;
+
+double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+double bench(size_t num_chunks) {
+    initialize_allocator(&a);
+    void **chunks = malloc(num_chunks * sizeof(void *));
+    for (size_t i = 0; i < num_chunks; i++)
+        chunks[i] = allo_cate(&a, CHUNK_BYTES);
+
+    unsigned seed = 1687792828;
+    double start = now();
+    for (size_t i = 0; i < NUM_OPS; i++) {
+        size_t j = rand_r(&seed) % num_chunks;
+        allo_free(&a, chunks[j]);
+        chunks[j] = allo_cate(&a, CHUNK_BYTES);
+    }
+    double elapsed = now() - start;
+
+    printf("%10lu %10lu %12.1f ns\n", a.stats.total_heap_size / HEAP_SIZE,
+           num_chunks, elapsed / NUM_OPS * 1e9);
+    free(chunks);
+    free_allocator(&a);
+    return elapsed;
+}
+
+int main(void) {
+    printf("%10s %10s %15s\n", "heaps", "chunks", "free + alloc");
+    for (size_t n = 4; n <= 16384; n *= 4)
+        bench(n);
+    return 0;
+}
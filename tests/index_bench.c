@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "allo.h"
+#include "avl_tree/avl_tree.h"
+#include "tlsf/tlsf.h"
+
+#define NUM_OPS 1000000
+
+// the medium path's free chunk index on its own: search for a fit, take it
+// out and put a chunk of a random size back, on a steady population of
+// chunks. the nodes only need headers so they live in a plain array
+double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+size_t random_size(unsigned *seed) {
+    return CHUNK_SIZE(32 + rand_r(seed) % (MIN_MMAP - 32));
+}
+
+void init_nodes(free_chunk_tree *nodes, size_t n, unsigned seed) {
+    for (size_t i = 0; i < n; i++)
+        nodes[i] = (free_chunk_tree){.status = random_size(&seed) | FREE};
+}
+
+double bench_avl(free_chunk_tree *nodes, size_t n) {
+    unsigned seed = 1687792828;
+    init_nodes(nodes, n, seed);
+    tree_node *root = NULL;
+    for (size_t i = 0; i < n; i++)
+        root = avl_tree_insert(root, &nodes[i]);
+
+    double start = now();
+    for (size_t i = 0; i < NUM_OPS; i++) {
+        size_t size = random_size(&seed);
+        node *found = avl_tree_search(root, size);
+        if (!found)
+            found = (node *)&nodes[rand_r(&seed) % n];
+        root = avl_tree_remove_node(root, found);
+        *(free_chunk_tree *)found =
+            (free_chunk_tree){.status = random_size(&seed) | FREE};
+        root = avl_tree_insert(root, (tree_node *)found);
+    }
+    return now() - start;
+}
+
+double bench_tlsf(free_chunk_tree *nodes, size_t n) {
+    unsigned seed = 1687792828;
+    init_nodes(nodes, n, seed);
+    tlsf_index t;
+    tlsf_init(&t);
+    for (size_t i = 0; i < n; i++)
+        tlsf_insert(&t, (node *)&nodes[i]);
+
+    double start = now();
+    for (size_t i = 0; i < NUM_OPS; i++) {
+        size_t size = random_size(&seed);
+        node *found = tlsf_search(&t, size);
+        if (!found)
+            found = (node *)&nodes[rand_r(&seed) % n];
+        tlsf_remove(&t, found);
+        found->status = random_size(&seed) | FREE;
+        tlsf_insert(&t, found);
+    }
+    return now() - start;
+}
+
+int main(void) {
+    printf("%10s %15s %15s\n", "chunks", "avl", "tlsf");
+    for (size_t n = 16; n <= 65536; n *= 4) {
+        free_chunk_tree *nodes = malloc(n * sizeof(free_chunk_tree));
+        double avl = bench_avl(nodes, n);
+        double tlsf = bench_tlsf(nodes, n);
+        printf("%10lu %12.1f ns %12.1f ns\n", n, avl / NUM_OPS * 1e9,
+               tlsf / NUM_OPS * 1e9);
+        free(nodes);
+    }
+    return 0;
+}
@@ -0,0 +1,55 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "allo.h"
+#include "pagemap.h"
+
+allocator a;
+
+void test_reuse(void) {
+    char *p = allo_cate(&a, 200000);
+    memset(p, 1, 200000);
+    allo_free(&a, p);
+    assert(a.stats.mmap_cache_bytes > 0);
+    // cached spans aren't allo's until handed out again
+    assert(PAGEMAP_KIND(pagemap_get(p)) == PAGE_NONE);
+
+    uint64_t hits = a.stats.mmap_cache_hits;
+    char *q = allo_cate(&a, 150000);
+    assert(q == p);
+    assert(a.stats.mmap_cache_hits == hits + 1);
+    assert(a.stats.mmap_cache_bytes == 0);
+    assert(allo_owns(&a, q + 199999));
+    assert(introspect_size(q) >= 200000);
+    allo_free(&a, q);
+
+    // nothing cached is big enough
+    uint64_t misses = a.stats.mmap_cache_misses;
+    char *r = allo_cate(&a, 1 << 20);
+    assert(a.stats.mmap_cache_misses == misses + 1);
+    allo_free(&a, r);
+}
+
+void test_budget(void) {
+    void *chunks[64];
+    for (size_t i = 0; i < 64; i++)
+        chunks[i] = allo_cate(&a, (size_t)1 << 20);
+    for (size_t i = 0; i < 64; i++)
+        allo_free(&a, chunks[i]);
+    assert(a.stats.mmap_cache_bytes <= MMAP_CACHE_BUDGET);
+    assert(a.stats.mmap_cache_bytes > MMAP_CACHE_BUDGET / 2);
+    assert(a.stats.num_bytes_allocated == 0);
+}
+
+int main(void) {
+    initialize_allocator(&a);
+
+    test_reuse();
+    test_budget();
+
+    free_allocator(&a);
+    assert(a.stats.mmap_cache_bytes == 0);
+    printf("Test passed: freed mmapped chunks were reused within budget.\n");
+    return 0;
+}
@@ -0,0 +1,156 @@
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "allo.h"
+
+#define NUM_THREADS 4
+#define PER_THREAD 20000
+
+void check_ours(void *p) {
+    assert(p != nullptr);
+    // global_allocator, or the thread's own with ALLO_THREAD_HEAPS
+    assert(allo_owner(p) != nullptr);
+}
+
+struct small {
+    int x;
+    ~small() { x = 0; }
+};
+
+struct alignas(64) line {
+    char data[100];
+};
+
+struct alignas(8192) page {
+    char data[10000];
+};
+
+void test_plain(void) {
+    // sized delete of every size class and of the heap/mmap paths
+    for (size_t size = 1; size < 300000; size = size * 5 / 4 + 1) {
+        char *p = static_cast<char *>(::operator new(size));
+        check_ours(p);
+        p[0] = p[size - 1] = 1;
+        ::operator delete(p, size);
+    }
+
+    small *s = new small{1};
+    check_ours(s);
+    delete s;
+
+    // arrays with destructors carry a cookie, and get a sized delete[]
+    small *arr = new small[1000];
+    check_ours(arr);
+    delete[] arr;
+
+    std::vector<std::string> strings;
+    std::map<int, std::string> map;
+    for (int i = 0; i < 10000; i++) {
+        strings.push_back(std::string(i % 100, 'a'));
+        map[i] = strings.back();
+    }
+    check_ours(strings.data());
+    for (int i = 0; i < 10000; i++)
+        assert(map[i].size() == (size_t)(i % 100));
+}
+
+void test_aligned(void) {
+    line *l = new line;
+    check_ours(l);
+    assert((uintptr_t)l % 64 == 0);
+    delete l;
+
+    line *ls = new line[37];
+    assert((uintptr_t)ls % 64 == 0);
+    delete[] ls;
+
+    page *p = new page;
+    check_ours(p);
+    assert((uintptr_t)p % 8192 == 0);
+    delete p;
+
+    page *ps = new page[3];
+    assert((uintptr_t)ps % 8192 == 0);
+    delete[] ps;
+
+    void *q = ::operator new(100, std::align_val_t(1 << 16), std::nothrow);
+    assert((uintptr_t)q % (1 << 16) == 0);
+    ::operator delete(q, std::align_val_t(1 << 16), std::nothrow);
+}
+
+int handler_calls;
+
+void give_up_after_three(void) {
+    if (++handler_calls == 3)
+        std::set_new_handler(nullptr);
+}
+
+void throw_bad_alloc(void) {
+    handler_calls++;
+    throw std::bad_alloc();
+}
+
+void test_failure(void) {
+    size_t huge = SIZE_MAX / 2 + 1;
+
+    bool thrown = false;
+    try {
+        void *p = ::operator new(huge);
+        (void)p;
+    } catch (const std::bad_alloc &) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    // the handler runs until it uninstalls itself, then it's bad_alloc
+    handler_calls = 0;
+    std::set_new_handler(give_up_after_three);
+    thrown = false;
+    try {
+        void *p = ::operator new(huge, std::align_val_t(4096));
+        (void)p;
+    } catch (const std::bad_alloc &) {
+        thrown = true;
+    }
+    assert(thrown && handler_calls == 3);
+
+    // nothrow new also runs the handler, but turns its throw into null
+    handler_calls = 0;
+    std::set_new_handler(throw_bad_alloc);
+    assert(::operator new(huge, std::nothrow) == nullptr);
+    assert(::operator new[](huge, std::align_val_t(64), std::nothrow)
+           == nullptr);
+    assert(handler_calls == 2);
+    std::set_new_handler(nullptr);
+}
+
+void churn(void) {
+    std::vector<std::unique_ptr<std::string>> live(64);
+    for (int i = 0; i < PER_THREAD; i++) {
+        live[rand() % 64] = std::make_unique<std::string>(rand() % 2000, 'x');
+    }
+}
+
+void test_threads(void) {
+    std::vector<std::thread> threads;
+    for (int i = 0; i < NUM_THREADS; i++)
+        threads.emplace_back(churn);
+    for (auto &t : threads)
+        t.join();
+}
+
+int main(void) {
+    test_plain();
+    test_aligned();
+    test_failure();
+    test_threads();
+    printf("Test passed: new and delete went through allo.\n");
+    return 0;
+}
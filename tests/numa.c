@@ -0,0 +1,143 @@
+#define _GNU_SOURCE
+#include <assert.h>
+#include <stdbool.h>
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "allo.h"
+#include "numa.h"
+
+#define NUM_THREADS 4
+#define PER_THREAD 2000
+
+// whether this kernel lets us mbind at all
+bool mbind_allowed(void) {
+    void *p = mmap(NULL, PAGE_SIZE, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    assert(p != MAP_FAILED);
+    unsigned long mask[ALLO_MAX_NUMA_NODES / 64] = {0};
+    int node = allo_numa_current_node();
+    mask[node / 64] = 1ul << (node % 64);
+    bool allowed = syscall(SYS_mbind, p, PAGE_SIZE, MPOL_PREFERRED, mask,
+                           ALLO_MAX_NUMA_NODES + 1, 0)
+                   == 0;
+    munmap(p, PAGE_SIZE);
+    return allowed;
+}
+
+// the page's policy is the node's while it is being bound, otherwise unset
+void check_bound(void *p, int node) {
+    int mode;
+    unsigned long mask[ALLO_MAX_NUMA_NODES / 64] = {0};
+    if (syscall(SYS_get_mempolicy, &mode, mask, ALLO_MAX_NUMA_NODES + 1, p,
+                MPOL_F_ADDR)
+        != 0)
+        return;
+    if (!allo_numa_bound(node)) {
+        assert(mode == MPOL_DEFAULT);
+        return;
+    }
+    assert(mode == MPOL_PREFERRED);
+    assert(mask[node / 64] & (1ul << (node % 64)));
+}
+
+void test_placement(void) {
+    int node = allo_numa_current_node();
+    assert(node < allo_numa_nodes());
+    allocator *a = allo_numa_allocator(node);
+    assert(a != NULL && a->numa_node == node);
+
+    uint64_t local = a->stats.numa_local_allocations;
+    size_t sizes[] = {16, 800, 5000, 50000, 500000};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        char *p = allo_cate_on_node(node, sizes[i]);
+        assert(p != NULL && allo_owns(a, p));
+        memset(p, 1, sizes[i]);
+        check_bound(p, node);
+        allo_numa_free(p);
+    }
+    assert(a->stats.numa_local_allocations - local
+           == sizeof(sizes) / sizeof(sizes[0]));
+    // binding didn't get switched off along the way
+    if (mbind_allowed())
+        assert(allo_numa_bound(node));
+}
+
+// a node mbind refuses (here one that doesn't exist) stays unbound on its
+// own, the others carry on being bound
+void test_refused_node(void) {
+    int bad = ALLO_MAX_NUMA_NODES - 1;
+    if (!mbind_allowed() || allo_numa_allocator(bad) != NULL)
+        return;
+    char *scratch = mmap(NULL, PAGE_SIZE, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    assert(!numa_bind(scratch, PAGE_SIZE, bad));
+    assert(!allo_numa_bound(bad));
+    munmap(scratch, PAGE_SIZE);
+
+    int node = allo_numa_current_node();
+    assert(allo_numa_bound(node));
+    // a fresh mapping, bound after the refusal
+    char *p = allo_cate_on_node(node, 1 << 20);
+    memset(p, 1, 1 << 20);
+    check_bound(p, node);
+    allo_numa_free(p);
+}
+
+void test_other_nodes(void) {
+    assert(allo_numa_allocator(-1) == NULL);
+    assert(allo_cate_on_node(ALLO_MAX_NUMA_NODES, 10) == NULL);
+    int here = allo_numa_current_node();
+    for (int node = 0; node < allo_numa_nodes(); node++) {
+        allocator *a = allo_numa_allocator(node);
+        if (a == NULL || node == here)
+            continue;
+        uint64_t remote = a->stats.numa_remote_allocations;
+        void *p = allo_cate_on_node(node, 3000);
+        check_bound(p, node);
+        assert(a->stats.numa_remote_allocations == remote + 1);
+        allo_numa_free(p);
+    }
+}
+
+void *ptrs[NUM_THREADS][PER_THREAD];
+
+void *worker(void *arg) {
+    size_t t = (size_t)arg;
+    for (size_t i = 0; i < PER_THREAD; i++) {
+        ptrs[t][i] = allo_numa_cate(8 + i * 37 % 3000);
+        assert(ptrs[t][i] != NULL);
+    }
+    return NULL;
+}
+
+// frees land on whichever node owns the memory
+void test_threads(void) {
+    pthread_t threads[NUM_THREADS];
+    for (size_t t = 0; t < NUM_THREADS; t++)
+        pthread_create(&threads[t], NULL, worker, (void *)t);
+    for (size_t t = 0; t < NUM_THREADS; t++)
+        pthread_join(threads[t], NULL);
+    for (size_t t = 0; t < NUM_THREADS; t++) {
+        for (size_t i = 0; i < PER_THREAD; i++)
+            allo_numa_free(ptrs[NUM_THREADS - 1 - t][i]);
+    }
+}
+
+int main(void) {
+    assert(allo_numa_nodes() >= 1);
+    test_placement();
+    test_refused_node();
+    test_other_nodes();
+    test_threads();
+
+    printf("Test passed: memory was placed on %d NUMA node(s).\n",
+           allo_numa_nodes());
+    return 0;
+}
@@ -0,0 +1,108 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "allo.h"
+#include "pagemap.h"
+
+allocator a, b;
+
+void test_owns(void) {
+    size_t sizes[] = {1, 24, 100, 1000, 5000, 40000, 100000, 3000000};
+    void *from_a[sizeof(sizes) / sizeof(sizes[0])];
+    void *from_b[sizeof(sizes) / sizeof(sizes[0])];
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        from_a[i] = allo_cate(&a, sizes[i]);
+        from_b[i] = allo_cate(&b, sizes[i]);
+        assert(allo_owns(&a, from_a[i]) && !allo_owns(&b, from_a[i]));
+        assert(allo_owns(&b, from_b[i]) && !allo_owns(&a, from_b[i]));
+        assert(allo_owner(from_a[i]) == &a);
+        // the end of the allocation is classified the same as the start
+        assert(allo_owns(&a, (char *)from_a[i] + sizes[i] - 1));
+    }
+
+    int on_stack;
+    assert(!allo_owns(&a, &on_stack));
+    assert(!allo_owns(&a, &a));
+    assert(!allo_owns(&a, NULL));
+    assert(PAGEMAP_KIND(pagemap_get(&on_stack)) == PAGE_NONE);
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        allo_free(&a, from_a[i]);
+        allo_free(&b, from_b[i]);
+    }
+}
+
+void test_introspect_size(void) {
+    size_t sizes[] = {1, 17, 24, 100, 129, 1000, 1025, 5000, 70000, 1 << 20};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        char *p = allo_cate(&a, sizes[i]);
+        size_t usable = introspect_size(p);
+        assert(usable >= sizes[i]);
+        // all of it is writable
+        memset(p, 0xab, usable);
+        allo_free(&a, p);
+    }
+}
+
+void test_size_classes(void) {
+    for (size_t n = 1; n <= MAX_ARENA_SIZE; n++) {
+        size_t rounded = round_to_alloc_size_without_metadata(n);
+        assert(rounded >= n);
+        assert(rounded == arena_bucket_size(get_arena_bucket(n)));
+        // at most a quarter wasted past the linear classes
+        assert(n <= ARENA_DOUBLING_SIZE || (rounded - n) * 4 < n);
+    }
+    assert(round_to_alloc_size_without_metadata(260) == 320);
+}
+
+void test_mmapped_pages_released(void) {
+    char *p = allo_cate(&a, 200000);
+    assert(PAGEMAP_KIND(pagemap_get(p)) == PAGE_MMAPPED);
+    allo_free(&a, p);
+    assert(PAGEMAP_KIND(pagemap_get(p)) == PAGE_NONE);
+    assert(!allo_owns(&a, p));
+}
+
+void test_slab_objects_packed(void) {
+    // no header between small objects of one size
+    char *p = allo_cate(&a, MIN_ALLOC_SIZE);
+    char *q = allo_cate(&a, MIN_ALLOC_SIZE);
+    pagemap_entry entry = pagemap_get(p);
+    assert(PAGEMAP_KIND(entry) == PAGE_SLAB);
+    assert(PAGEMAP_SIZE_CLASS(entry) == get_arena_bucket(MIN_ALLOC_SIZE));
+    assert(q == p + MIN_ALLOC_SIZE);
+    assert(introspect_size(p) == MIN_ALLOC_SIZE);
+    allo_free(&a, p);
+    allo_free(&a, q);
+}
+
+void test_medium_chunks_packed(void) {
+    allocator c;
+    initialize_allocator(&c);
+    // consecutive medium chunks of a fresh heap are one 16 byte header apart
+    char *p = allo_cate(&c, 2000);
+    char *q = allo_cate(&c, 2000);
+    assert(introspect_size(p) == 2000);
+    assert(q == p + 2000 + 16);
+    assert((uint64_t)p % 16 == 0);
+    free_allocator(&c);
+}
+
+int main(void) {
+    initialize_allocator(&a);
+    initialize_allocator(&b);
+
+    test_owns();
+    test_introspect_size();
+    test_size_classes();
+    test_mmapped_pages_released();
+    test_slab_objects_packed();
+    test_medium_chunks_packed();
+
+    free_allocator(&a);
+    free_allocator(&b);
+    printf("Test passed: the page map classifies every allocation.\n");
+    return 0;
+}
@@ -0,0 +1,63 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "allo.h"
+#include "percpu.h"
+
+#define NUM_THREADS 8
+#define NUM_ROUNDS 200
+#define NUM_LIVE 128
+
+void *worker(void *p) {
+    unsigned char id = (unsigned char)(size_t)p;
+    unsigned seed = id;
+    unsigned char *live[NUM_LIVE] = {NULL};
+    size_t sz[NUM_LIVE] = {0};
+
+    for (int round = 0; round < NUM_ROUNDS; round++) {
+        for (int i = 0; i < NUM_LIVE; i++) {
+            if (live[i] != NULL) {
+                for (size_t j = 0; j < sz[i]; j++)
+                    assert(live[i][j] == id);
+                assert(percpu_free(&global_allocator, live[i],
+                                   get_arena_bucket(sz[i])));
+                live[i] = NULL;
+            }
+            if (rand_r(&seed) % 2 == 0)
+                continue;
+            sz[i] = round_to_alloc_size_without_metadata(rand_r(&seed)
+                                                         % MAX_ARENA_SIZE + 1);
+            live[i] = percpu_allo_cate(&global_allocator, sz[i]);
+            assert(live[i] != NULL);
+            memset(live[i], id, sz[i]);
+        }
+    }
+    for (int i = 0; i < NUM_LIVE; i++)
+        if (live[i] != NULL)
+            percpu_free(&global_allocator, live[i], get_arena_bucket(sz[i]));
+    return NULL;
+}
+
+int main(void) {
+    if (!percpu_available()) {
+        printf("Test skipped: rseq is not available.\n");
+        return 0;
+    }
+
+    pthread_t threads[NUM_THREADS];
+    for (size_t i = 0; i < NUM_THREADS; i++)
+        pthread_create(&threads[i], NULL, worker, (void *)(i + 1));
+    for (size_t i = 0; i < NUM_THREADS; i++)
+        pthread_join(threads[i], NULL);
+
+    // chunks handed out through the per-CPU caches work with plain free too
+    void *p = percpu_allo_cate(&global_allocator, 64);
+    _allo_free(p);
+
+    printf("Test passed: %d threads shared the per-CPU caches.\n",
+           NUM_THREADS);
+    return 0;
+}
@@ -0,0 +1,137 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "allo.h"
+#include "pagemap.h"
+#include "persistent.h"
+
+#define PATH "/dev/shm/allo_persistent_test"
+#define NUM_NODES 2000
+
+// an index of nodes of every size class, some with big payloads
+typedef struct node {
+    struct node *next;
+    uint64_t key;
+    size_t len;
+    char *payload;
+} node;
+
+size_t payload_len(uint64_t key) {
+    switch (key % 4) {
+    case 0:
+        return 1 + key % 200;
+    case 1:
+        return 1500 + key;
+    case 2:
+        return 20000;
+    default:
+        return key % 10 == 3 ? 300000 : 40;
+    }
+}
+
+void build(allocator *a) {
+    node *head = NULL;
+    for (uint64_t key = 0; key < NUM_NODES; key++) {
+        node *n = allo_cate(a, sizeof(node));
+        n->key = key;
+        n->len = payload_len(key);
+        n->payload = allo_cate(a, n->len);
+        memset(n->payload, (int)key, n->len);
+        n->next = head;
+        head = n;
+    }
+    *allo_persistent_root(a) = head;
+}
+
+void check(allocator *a, uint64_t count) {
+    uint64_t seen = 0;
+    for (node *n = *allo_persistent_root(a); n != NULL; n = n->next) {
+        assert(allo_owns(a, n));
+        assert(allo_owns(a, n->payload));
+        assert(n->len == payload_len(n->key));
+        assert(introspect_size(n->payload) >= n->len);
+        for (size_t i = 0; i < n->len; i += 97)
+            assert(n->payload[i] == (char)n->key);
+        seen++;
+    }
+    assert(seen == count);
+}
+
+// free every other node and replace its payload on the rest
+uint64_t churn(allocator *a) {
+    node **link = (node **)allo_persistent_root(a);
+    uint64_t count = 0;
+    while (*link != NULL) {
+        node *n = *link;
+        if (n->key % 2 == 0) {
+            *link = n->next;
+            allo_free(a, n->payload);
+            allo_free(a, n);
+            continue;
+        }
+        allo_free(a, n->payload);
+        n->payload = allo_cate(a, n->len);
+        memset(n->payload, (int)n->key, n->len);
+        link = &n->next;
+        count++;
+    }
+    return count;
+}
+
+int main(void) {
+    unlink(PATH);
+    allocator *a = allo_open_persistent(PATH, 256 << 20);
+    assert(a != NULL);
+    assert((uint64_t)a->backing == ALLO_PERSISTENT_BASE);
+    build(a);
+    check(a, NUM_NODES);
+    // a second heap can't take the same address
+    assert(allo_open_persistent(PATH ".2", 1 << 20) == NULL);
+    unlink(PATH ".2");
+    void *root = *allo_persistent_root(a);
+    allo_close_persistent(a);
+    assert(PAGEMAP_KIND(pagemap_get(root)) == PAGE_NONE);
+
+    // back in this process
+    a = allo_open_persistent(PATH, 0);
+    assert(a != NULL);
+    check(a, NUM_NODES);
+    uint64_t count = churn(a);
+    check(a, count);
+    allo_close_persistent(a);
+
+    // and in another one
+    pid_t pid = fork();
+    if (pid == 0) {
+        allocator *b = allo_open_persistent(PATH, 0);
+        assert(b != NULL);
+        check(b, count);
+        count = churn(b);
+        check(b, count);
+        build(b);
+        allo_close_persistent(b);
+        _exit(0);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    a = allo_open_persistent(PATH, 0);
+    assert(a != NULL);
+    check(a, NUM_NODES);
+    allo_close_persistent(a);
+
+    // not a heap
+    FILE *f = fopen(PATH, "w");
+    fputs("hello", f);
+    fclose(f);
+    assert(allo_open_persistent(PATH, 0) == NULL);
+    unlink(PATH);
+
+    printf("Test passed: the persistent heap came back intact.\n");
+    return 0;
+}
@@ -0,0 +1,92 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "allo.h"
+#include "thread_allocator.h"
+
+#define NUM_MESSAGES 100000
+#define QUEUE_SIZE 1024
+
+// producer allocates on its own allocator, consumer frees them remotely
+typedef struct queue {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    size_t head, tail;
+    char *items[QUEUE_SIZE];
+} queue;
+
+queue q = {.lock = PTHREAD_MUTEX_INITIALIZER,
+           .cond = PTHREAD_COND_INITIALIZER};
+allocator *producer_allocator;
+
+size_t message_size(size_t i) {
+    // mostly arena sizes, some medium and the odd mmapped one
+    if (i % 1000 == 0)
+        return 100000;
+    if (i % 10 == 0)
+        return 2000 + i % 3000;
+    return i % 1000 + 1;
+}
+
+void *producer(void *arg) {
+    (void)arg;
+    producer_allocator = allo_thread_allocator();
+    for (size_t i = 0; i < NUM_MESSAGES; i++) {
+        size_t size = message_size(i);
+        char *m = allo_thread_cate(size);
+        assert(m != NULL);
+        assert(allo_owner(m) == producer_allocator);
+        memset(m, (char)i, size);
+
+        pthread_mutex_lock(&q.lock);
+        while (q.tail - q.head == QUEUE_SIZE)
+            pthread_cond_wait(&q.cond, &q.lock);
+        q.items[q.tail++ % QUEUE_SIZE] = m;
+        pthread_cond_broadcast(&q.cond);
+        pthread_mutex_unlock(&q.lock);
+    }
+    return NULL;
+}
+
+void *consumer(void *arg) {
+    (void)arg;
+    for (size_t i = 0; i < NUM_MESSAGES; i++) {
+        pthread_mutex_lock(&q.lock);
+        while (q.tail == q.head)
+            pthread_cond_wait(&q.cond, &q.lock);
+        char *m = q.items[q.head++ % QUEUE_SIZE];
+        pthread_cond_broadcast(&q.cond);
+        pthread_mutex_unlock(&q.lock);
+
+        size_t size = message_size(i);
+        for (size_t j = 0; j < size; j++)
+            assert(m[j] == (char)i);
+        allo_thread_free(m);
+    }
+    return NULL;
+}
+
+int main(void) {
+    pthread_t p, c;
+    pthread_create(&p, NULL, producer, NULL);
+    pthread_create(&c, NULL, consumer, NULL);
+    pthread_join(p, NULL);
+    pthread_join(c, NULL);
+
+    // the producer's allocator was abandoned on exit and is adopted here
+    allocator *a = allo_thread_allocator();
+    assert(a == producer_allocator);
+    // allocating reclaims everything the consumer freed, and the remotely
+    // freed chunks were reused rather than growing the heaps
+    void *p1 = allo_thread_cate(5000);
+    assert(a->remote_frees == NULL);
+    assert(a->stats.total_heap_size < 32 * HEAP_SIZE);
+    allo_thread_free(p1);
+
+    printf("Test passed: %d messages freed by another thread.\n",
+           NUM_MESSAGES);
+    return 0;
+}
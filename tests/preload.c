@@ -0,0 +1,134 @@
+#define _GNU_SOURCE
+#include <assert.h>
+#include <dlfcn.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// built without allo.h, run under LD_PRELOAD=liballo.so like any other binary
+
+#define NUM_THREADS 4
+#define PER_THREAD 5000
+
+typedef void *(*owner_fn)(void *);
+
+owner_fn owner;
+
+void check_ours(void *p) {
+    assert(p != NULL);
+    // global_allocator, or the thread's own with ALLO_THREAD_HEAPS
+    assert(owner(p) != NULL);
+}
+
+void test_family(void) {
+    char *p = malloc(100);
+    check_ours(p);
+    assert(malloc_usable_size(p) >= 100);
+    memset(p, 'a', 100);
+
+    p = realloc(p, 100000);
+    check_ours(p);
+    for (int i = 0; i < 100; i++)
+        assert(p[i] == 'a');
+    free(p);
+
+    char *z = calloc(1000, 10);
+    check_ours(z);
+    for (int i = 0; i < 10000; i++)
+        assert(z[i] == 0);
+    free(z);
+    // nmemb * size overflows, which gcc would warn about if it could see it
+    volatile size_t huge = SIZE_MAX / 2;
+    assert(calloc(huge, 4) == NULL);
+
+    size_t aligns[] = {16, 64, 4096, 1 << 16};
+    for (size_t i = 0; i < sizeof(aligns) / sizeof(aligns[0]); i++) {
+        void *a;
+        assert(posix_memalign(&a, aligns[i], 300) == 0);
+        check_ours(a);
+        assert((uintptr_t)a % aligns[i] == 0);
+        free(a);
+
+        a = aligned_alloc(aligns[i], aligns[i] * 2);
+        check_ours(a);
+        assert((uintptr_t)a % aligns[i] == 0);
+        free(a);
+
+        a = memalign(aligns[i], 5000);
+        check_ours(a);
+        assert((uintptr_t)a % aligns[i] == 0);
+        free(a);
+    }
+
+    void *v = valloc(10);
+    assert((uintptr_t)v % 4096 == 0);
+    free(v);
+    free(NULL);
+
+    // libc's own allocations go through us too
+    char *s = strdup("hello");
+    check_ours(s);
+    free(s);
+}
+
+// runs in forked children too, where rand's lock may have been held by
+// another thread at the fork, so the state is local
+void *churn(void *arg) {
+    (void)arg;
+    unsigned seed = (unsigned)(uintptr_t)&seed;
+    void *ptrs[64] = {0};
+    for (int i = 0; i < PER_THREAD; i++) {
+        int j = rand_r(&seed) % 64;
+        free(ptrs[j]);
+        ptrs[j] = malloc(1 + rand_r(&seed) % 20000);
+        memset(ptrs[j], i, 1);
+    }
+    for (int j = 0; j < 64; j++)
+        free(ptrs[j]);
+    return NULL;
+}
+
+void test_threads(void) {
+    pthread_t threads[NUM_THREADS];
+    for (int i = 0; i < NUM_THREADS; i++)
+        pthread_create(&threads[i], NULL, churn, NULL);
+    for (int i = 0; i < NUM_THREADS; i++)
+        pthread_join(threads[i], NULL);
+}
+
+void test_fork(void) {
+    // another thread keeps allocating while we fork
+    pthread_t t;
+    pthread_create(&t, NULL, churn, NULL);
+    for (int i = 0; i < 20; i++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            churn(NULL);
+            _exit(0);
+        }
+        int status;
+        assert(waitpid(pid, &status, 0) == pid);
+        assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+    pthread_join(t, NULL);
+}
+
+int main(void) {
+    owner = (owner_fn)dlsym(RTLD_DEFAULT, "allo_owner");
+    if (owner == NULL) {
+        fprintf(stderr, "liballo.so is not preloaded\n");
+        return 1;
+    }
+
+    test_family();
+    test_threads();
+    test_fork();
+    malloc_trim(0);
+    printf("preload ok\n");
+    return 0;
+}
@@ -0,0 +1,117 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "allo.h"
+#include "pagemap.h"
+
+allocator a;
+
+void fill(char *p, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        p[i] = (char)(i * 7);
+}
+
+void check(char *p, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        assert(p[i] == (char)(i * 7));
+}
+
+void test_medium_grow_in_place(void) {
+    // fresh heap, so everything after p is one free chunk
+    char *p = allo_cate(&a, 2000);
+    fill(p, 2000);
+    uint64_t before = a.stats.num_bytes_allocated;
+    char *q = allo_realloc(&a, p, 8000);
+    assert(q == p);
+    assert(introspect_size(q) >= 8000);
+    assert(a.stats.num_bytes_allocated > before);
+    check(q, 2000);
+    allo_free(&a, q);
+}
+
+void test_medium_shrink(void) {
+    char *p = allo_cate(&a, 20000);
+    fill(p, 20000);
+    char *q = allo_realloc(&a, p, 3000);
+    assert(q == p);
+    assert(introspect_size(q) < 20000);
+    check(q, 3000);
+    // the tail went back to the heap
+    char *r = allo_cate(&a, 10000);
+    assert(r > q && r < q + 20000);
+    allo_free(&a, r);
+    allo_free(&a, q);
+}
+
+void test_medium_moves_when_blocked(void) {
+    char *p = allo_cate(&a, 2000);
+    char *blocker = allo_cate(&a, 2000);
+    fill(p, 2000);
+    char *q = allo_realloc(&a, p, 8000);
+    assert(q != p);
+    check(q, 2000);
+    allo_free(&a, q);
+    allo_free(&a, blocker);
+}
+
+void test_mmapped(void) {
+    size_t n = 200000;
+    char *p = allo_cate(&a, n);
+    fill(p, n);
+    char *q = allo_realloc(&a, p, 4 << 20);
+    assert(introspect_size(q) >= (4 << 20));
+    assert(allo_owns(&a, q + (4 << 20) - 1));
+    check(q, n);
+    memset(q + n, 1, (4 << 20) - n);
+
+    // back down to a medium chunk, which has to move
+    char *r = allo_realloc(&a, q, 5000);
+    assert(PAGEMAP_KIND(pagemap_get(r)) == PAGE_HEAP);
+    check(r, 5000);
+    allo_free(&a, r);
+    assert(a.stats.num_bytes_allocated == 0);
+}
+
+void test_slab(void) {
+    char *p = allo_cate(&a, 20);
+    fill(p, 20);
+    assert(allo_realloc(&a, p, 24) == p);
+    char *q = allo_realloc(&a, p, 500);
+    assert(q != p);
+    check(q, 20);
+    char *r = allo_realloc(&a, q, 10);
+    check(r, 10);
+    allo_free(&a, r);
+}
+
+void test_vector_growth(void) {
+    char *v = realloc(NULL, 1);
+    size_t len = 0;
+    for (size_t cap = 1; cap <= (1 << 22); cap *= 2) {
+        v = realloc(v, cap);
+        assert(v != NULL);
+        check(v, len);
+        fill(v, cap);
+        len = cap;
+    }
+    v = realloc(v, 100);
+    check(v, 100);
+    free(v);
+}
+
+int main(void) {
+    initialize_allocator(&a);
+
+    test_medium_grow_in_place();
+    test_medium_shrink();
+    test_medium_moves_when_blocked();
+    test_mmapped();
+    test_slab();
+    test_vector_growth();
+
+    free_allocator(&a);
+    printf("Test passed: realloc resized in place where it could.\n");
+    return 0;
+}
@@ -0,0 +1,87 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "allo.h"
+#include "region.h"
+
+allocator a;
+
+void test_bump(void) {
+    allo_region r;
+    allo_region_init(&r, &a, 0);
+    char *prev = allo_region_cate(&r, 10);
+    for (size_t i = 0; i < 100; i++) {
+        char *p = allo_region_cate(&r, 10);
+        assert(((uint64_t)p & 15) == 0);
+        assert(p == prev + 16);
+        memset(p, 1, 10);
+        prev = p;
+    }
+    allo_region_destroy(&r);
+}
+
+void test_reset_reuses_blocks(void) {
+    allo_region r;
+    allo_region_init(&r, &a, 4096);
+    void *first = allo_region_cate(&r, 100);
+    for (size_t i = 0; i < 10000; i++)
+        memset(allo_region_cate(&r, 50), 2, 50);
+    // big ones get blocks of their own
+    memset(allo_region_cate(&r, 100000), 3, 100000);
+
+    uint64_t allocated = a.stats.num_bytes_allocated;
+    for (size_t round = 0; round < 10; round++) {
+        allo_region_reset(&r);
+        assert(allo_region_cate(&r, 100) == first);
+        for (size_t i = 0; i < 10000; i++)
+            memset(allo_region_cate(&r, 50), 2, 50);
+        memset(allo_region_cate(&r, 100000), 3, 100000);
+        assert(a.stats.num_bytes_allocated == allocated);
+    }
+
+    allo_region_destroy(&r);
+}
+
+void test_marks(void) {
+    allo_region r;
+    allo_region_init(&r, &a, 1024);
+    allo_region_mark empty = allo_region_save(&r);
+    char *outer = allo_region_cate(&r, 100);
+    memset(outer, 'o', 100);
+
+    allo_region_mark m1 = allo_region_save(&r);
+    char *a1 = allo_region_cate(&r, 300);
+    for (size_t i = 0; i < 100; i++)
+        allo_region_cate(&r, 500);
+
+    allo_region_mark m2 = allo_region_save(&r);
+    char *a2 = allo_region_cate(&r, 64);
+    allo_region_restore(&r, m2);
+    assert(allo_region_cate(&r, 64) == a2);
+
+    allo_region_restore(&r, m1);
+    assert(allo_region_cate(&r, 300) == a1);
+    for (size_t i = 0; i < 100; i++)
+        allo_region_cate(&r, 500);
+    for (size_t i = 0; i < 100; i++)
+        assert(outer[i] == 'o');
+
+    allo_region_restore(&r, empty);
+    assert(allo_region_cate(&r, 100) == outer);
+    allo_region_destroy(&r);
+}
+
+int main(void) {
+    initialize_allocator(&a);
+
+    test_bump();
+    test_reset_reuses_blocks();
+    test_marks();
+    assert(a.stats.num_bytes_allocated <= NUM_ARENA_BUCKETS * SLAB_SIZE);
+
+    free_allocator(&a);
+    printf("Test passed: regions bumped, reset and restored.\n");
+    return 0;
+}
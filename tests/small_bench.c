@@ -0,0 +1,40 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "allo.h"
+
+#define NUM_OBJECTS 1000000
+
+// heap bytes used per live small object, and allo_cate + allo_free latency
+allocator a;
+
+double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void bench(size_t size, void **objects) {
+    initialize_allocator(&a);
+    double start = now();
+    for (size_t i = 0; i < NUM_OBJECTS; i++)
+        objects[i] = allo_cate(&a, size);
+    for (size_t i = 0; i < NUM_OBJECTS; i++)
+        allo_free(&a, objects[i]);
+    double elapsed = now() - start;
+
+    printf("%10lu %15.2f %12.1f ns\n", size,
+           (double)a.stats.total_heap_size / NUM_OBJECTS,
+           elapsed / NUM_OBJECTS * 1e9);
+    free_allocator(&a);
+}
+
+int main(void) {
+    void **objects = malloc(NUM_OBJECTS * sizeof(void *));
+    printf("%10s %15s %15s\n", "size", "bytes/object", "cate + free");
+    for (size_t size = MIN_ALLOC_SIZE; size <= 128; size *= 2)
+        bench(size, objects);
+    free(objects);
+    return 0;
+}
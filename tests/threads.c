@@ -0,0 +1,117 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "allo.h"
+
+#define NUM_THREADS 8
+#define NUM_ROUNDS 200
+#define NUM_LIVE 256
+#define MAX_ALLOC_SIZE 1024
+
+typedef struct thread_arg {
+    unsigned seed;
+    unsigned char id;
+} thread_arg;
+
+void *worker(void *p) {
+    thread_arg *arg = p;
+    unsigned char *live[NUM_LIVE] = {NULL};
+    size_t sz[NUM_LIVE] = {0};
+
+    for (int round = 0; round < NUM_ROUNDS; round++) {
+        for (int i = 0; i < NUM_LIVE; i++) {
+            if (live[i] != NULL) {
+                for (size_t j = 0; j < sz[i]; j++)
+                    assert(live[i][j] == arg->id);
+                free(live[i]);
+                live[i] = NULL;
+            }
+            if (rand_r(&arg->seed) % 2 == 0)
+                continue;
+            sz[i] = rand_r(&arg->seed) % MAX_ALLOC_SIZE + 1;
+            live[i] = malloc(sz[i]);
+            assert(live[i] != NULL);
+            memset(live[i], arg->id, sz[i]);
+        }
+    }
+
+    // leave some chunks behind in the thread cache to be drained on exit
+    for (int i = 0; i < NUM_LIVE; i += 2) {
+        free(live[i]);
+        live[i] = NULL;
+    }
+    for (int i = 1; i < NUM_LIVE; i += 2) {
+        if (live[i] != NULL)
+            for (size_t j = 0; j < sz[i]; j++)
+                assert(live[i][j] == arg->id);
+        free(live[i]);
+    }
+    return NULL;
+}
+
+#define NUM_HANDOFFS 200
+#define HANDOFF_SIZE 1000
+
+// one thread only allocates and the other only frees, the freed chunks have to
+// make their way back to the allocating thread instead of growing the arenas
+void *handoff[HANDOFF_SIZE];
+pthread_barrier_t barrier;
+
+void *allocating(void *p) {
+    (void)p;
+    for (int round = 0; round < NUM_HANDOFFS; round++) {
+        for (int i = 0; i < HANDOFF_SIZE; i++)
+            handoff[i] = malloc(64);
+        pthread_barrier_wait(&barrier);
+        pthread_barrier_wait(&barrier);
+    }
+    return NULL;
+}
+
+void *freeing(void *p) {
+    (void)p;
+    for (int round = 0; round < NUM_HANDOFFS; round++) {
+        pthread_barrier_wait(&barrier);
+        for (int i = 0; i < HANDOFF_SIZE; i++)
+            free(handoff[i]);
+        pthread_barrier_wait(&barrier);
+    }
+    return NULL;
+}
+
+void test_imbalanced(void) {
+    pthread_t alloc_thread, free_thread;
+    pthread_barrier_init(&barrier, NULL, 2);
+    uint64_t heap_size = global_allocator.stats.total_heap_size;
+
+    pthread_create(&alloc_thread, NULL, allocating, NULL);
+    pthread_create(&free_thread, NULL, freeing, NULL);
+    pthread_join(alloc_thread, NULL);
+    pthread_join(free_thread, NULL);
+
+    // a handful of heaps hold every arena block the rounds ever need
+    assert(global_allocator.stats.total_heap_size - heap_size
+           <= 4 * HEAP_SIZE);
+    printf("Test passed: chunks freed on another thread were reused.\n");
+}
+
+int main(void) {
+    pthread_t threads[NUM_THREADS];
+    thread_arg args[NUM_THREADS];
+
+    for (int i = 0; i < NUM_THREADS; i++) {
+        args[i] = (thread_arg){.seed = 1687792828 + i, .id = i + 1};
+        pthread_create(&threads[i], NULL, worker, &args[i]);
+    }
+    for (int i = 0; i < NUM_THREADS; i++)
+        pthread_join(threads[i], NULL);
+
+    printf("Test passed: %d threads allocated and freed concurrently.\n",
+           NUM_THREADS);
+
+    test_imbalanced();
+    return 0;
+}
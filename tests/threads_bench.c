@@ -0,0 +1,83 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "allo.h"
+
+#define NUM_OPS 200000
+#define NUM_LIVE 64
+#define MAX_THREADS 8
+
+// throughput of allo_cate/allo_free on one shared allocator as the number of
+// threads grows, for small objects, medium objects and half of each
+allocator shared;
+
+typedef struct bench_arg {
+    size_t size;
+} bench_arg;
+
+void *worker(void *p) {
+    bench_arg *arg = p;
+    void *live[NUM_LIVE] = {NULL};
+    for (size_t i = 0; i < NUM_OPS; i++) {
+        size_t slot = i % NUM_LIVE;
+        if (live[slot] != NULL)
+            allo_free(&shared, live[slot]);
+        live[slot] = allo_cate(&shared, arg->size);
+        *(char *)live[slot] = (char)i;
+    }
+    for (size_t i = 0; i < NUM_LIVE; i++)
+        allo_free(&shared, live[i]);
+    return NULL;
+}
+
+double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// sizes[i % 2] for thread i
+double bench(int num_threads, size_t sizes[2]) {
+    pthread_t threads[MAX_THREADS];
+    bench_arg args[MAX_THREADS];
+
+    initialize_allocator(&shared);
+    double start = now();
+    for (int i = 0; i < num_threads; i++) {
+        args[i].size = sizes[i % 2];
+        pthread_create(&threads[i], NULL, worker, &args[i]);
+    }
+    for (int i = 0; i < num_threads; i++)
+        pthread_join(threads[i], NULL);
+    double elapsed = now() - start;
+    free_allocator(&shared);
+
+    return num_threads * (double)NUM_OPS / elapsed;
+}
+
+int main(void) {
+    struct {
+        const char *name;
+        size_t sizes[2];
+    } workloads[] = {
+        {"32 B", {32, 32}},
+        {"4 KiB", {4096, 4096}},
+        {"32 B + 4 KiB", {32, 4096}},
+    };
+
+    printf("%-14s", "threads");
+    for (int t = 1; t <= MAX_THREADS; t *= 2)
+        printf("%12d", t);
+    printf("\n");
+    for (size_t w = 0; w < sizeof(workloads) / sizeof(workloads[0]); w++) {
+        printf("%-14s", workloads[w].name);
+        for (int t = 1; t <= MAX_THREADS; t *= 2)
+            printf("%10.2fM", bench(t, workloads[w].sizes) / 1e6);
+        printf("\n");
+    }
+    printf("(allo_cate + allo_free pairs per second)\n");
+    return 0;
+}
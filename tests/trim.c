@@ -0,0 +1,193 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "allo.h"
+
+#define CHUNK_BYTES 30000
+#define NUM_CHUNKS 64
+
+allocator a;
+
+void test_free_heaps_unmapped(void) {
+    void *chunks[NUM_CHUNKS];
+    for (size_t i = 0; i < NUM_CHUNKS; i++)
+        chunks[i] = allo_cate(&a, CHUNK_BYTES);
+    uint64_t heap_size = a.stats.total_heap_size;
+    assert(heap_size >= 8 * HEAP_SIZE);
+    for (size_t i = 0; i < NUM_CHUNKS; i++)
+        allo_free(&a, chunks[i]);
+
+    // one heap is kept
+    size_t purged = allo_trim(&a, HEAP_SIZE);
+    assert(purged >= heap_size - HEAP_SIZE);
+    assert(a.stats.total_heap_size == HEAP_SIZE);
+    assert(a.stats.purged_bytes >= purged);
+
+    allo_trim(&a, 0);
+    assert(a.stats.total_heap_size == 0);
+
+    // and the allocator carries on as normal
+    char *p = allo_cate(&a, CHUNK_BYTES);
+    memset(p, 1, CHUNK_BYTES);
+    allo_free(&a, p);
+}
+
+void test_free_runs_purged(void) {
+    char *chunks[4];
+    for (size_t i = 0; i < 4; i++)
+        chunks[i] = allo_cate(&a, CHUNK_BYTES);
+    memset(chunks[1], 2, CHUNK_BYTES);
+    allo_free(&a, chunks[1]);
+    allo_free(&a, chunks[2]);
+
+    // the heap stays, the free pages between the live chunks go
+    uint64_t heap_size = a.stats.total_heap_size;
+    assert(allo_trim(&a, 0) >= CHUNK_BYTES);
+    assert(a.stats.total_heap_size == heap_size);
+    // already purged
+    assert(allo_trim(&a, 0) == 0);
+
+    // purged memory is handed out again
+    char *p = allo_cate(&a, 2 * CHUNK_BYTES);
+    memset(p, 3, 2 * CHUNK_BYTES);
+    allo_free(&a, p);
+    allo_free(&a, chunks[0]);
+    allo_free(&a, chunks[3]);
+}
+
+void test_mmap_cache_trimmed(void) {
+    allo_free(&a, allo_cate(&a, 1 << 20));
+    assert(a.stats.mmap_cache_bytes > 0);
+    allo_trim(&a, 0);
+    assert(a.stats.mmap_cache_bytes == 0);
+}
+
+void test_empty_slabs_reused(void) {
+    static void *objects[3000];
+    assert(a.stats.num_bytes_allocated == 0);
+    for (size_t i = 0; i < 3000; i++)
+        objects[i] = allo_cate(&a, 64);
+    for (size_t i = 0; i < 3000; i++)
+        allo_free(&a, objects[i]);
+    // all but the warm slabs went back
+    assert(a.stats.num_bytes_allocated == ARENA_WARM_SLABS * SLAB_SIZE);
+
+    // and serve another size class without growing
+    uint64_t heap_size = a.stats.total_heap_size;
+    for (size_t i = 0; i < 1000; i++)
+        objects[i] = allo_cate(&a, 128);
+    assert(a.stats.total_heap_size == heap_size);
+    for (size_t i = 0; i < 1000; i++)
+        allo_free(&a, objects[i]);
+
+    // the free slabs' pages
+    assert(allo_trim(&a, 0) > 0);
+    // and the warm slab too
+    assert(a.stats.num_bytes_allocated == 0);
+}
+
+void test_transfer_cache_trimmed(void) {
+    // a whole batch of one size is parked in the transfer cache
+    arena_free_chunk *head;
+    assert(allo_cate_arena_list(&a, 64, TRANSFER_BATCH, &head)
+           == TRANSFER_BATCH);
+    arena_free_chunk *tail = head;
+    while (tail->next != NULL)
+        tail = tail->next;
+    allo_free_arena_list(&a, get_arena_bucket(64), head, tail, TRANSFER_BATCH);
+    assert(a.stats.num_bytes_allocated > 0);
+    allo_trim(&a, 0);
+    assert(a.stats.num_bytes_allocated == 0);
+}
+
+// frees 3000 small objects, which empties slabs past the warm one
+void churn_slabs(void) {
+    static void *objects[3000];
+    for (size_t i = 0; i < 3000; i++)
+        objects[i] = allo_cate(&a, 64);
+    for (size_t i = 0; i < 3000; i++)
+        allo_free(&a, objects[i]);
+}
+
+void test_decay(void) {
+    if (ALLO_DECAY_MS == 0)
+        return;
+    uint64_t heap_size = a.stats.total_heap_size;
+    allo_free(&a, allo_cate(&a, CHUNK_BYTES));
+    assert(a.stats.total_heap_size == heap_size + HEAP_SIZE);
+    // decay passes run on frees, it takes two for the heap to count as idle
+    for (int i = 0; i < 3; i++) {
+        usleep(ALLO_DECAY_MS * 1100);
+        allo_free(&a, allo_cate(&a, 1 << 20));
+    }
+    assert(a.stats.total_heap_size == heap_size);
+}
+
+// pages of [p, p + n) the kernel has backed with memory
+size_t resident_pages(char *p, size_t n) {
+    char *start = (char *)((uint64_t)p & ~(PAGE_SIZE - 1));
+    size_t pages = (p + n - start + PAGE_SIZE - 1) / PAGE_SIZE;
+    static unsigned char vec[64];
+    assert(pages <= sizeof(vec));
+    assert(mincore(start, pages * PAGE_SIZE, vec) == 0);
+    size_t resident = 0;
+    for (size_t i = 0; i < pages; i++)
+        resident += vec[i] & 1;
+    return resident;
+}
+
+// decay skips heaps it has purged already, until they are used again
+void test_decay_repurges_used_heap(void) {
+    if (ALLO_DECAY_MS == 0)
+        return;
+    char *chunks[3];
+    for (size_t i = 0; i < 3; i++)
+        chunks[i] = allo_cate(&a, CHUNK_BYTES);
+    for (int round = 0; round < 2; round++) {
+        memset(chunks[1], 5, CHUNK_BYTES);
+        allo_free(&a, chunks[1]);
+        for (int i = 0; i < 3; i++) {
+            usleep(ALLO_DECAY_MS * 1100);
+            allo_free(&a, allo_cate(&a, 1 << 20));
+        }
+        // all but the pages the free chunk's header is on
+        assert(resident_pages(chunks[1] + 2 * PAGE_SIZE,
+                              CHUNK_BYTES - 4 * PAGE_SIZE)
+               == 0);
+        chunks[1] = allo_cate(&a, CHUNK_BYTES);
+    }
+    for (size_t i = 0; i < 3; i++)
+        allo_free(&a, chunks[i]);
+}
+
+void test_decay_on_small_frees(void) {
+    if (ALLO_DECAY_MS == 0)
+        return;
+    allo_free(&a, allo_cate(&a, 1 << 20));
+    uint64_t cached = a.stats.mmap_cache_bytes;
+    assert(cached > 0);
+    // nothing but small frees from here on, releasing slabs runs the pass
+    usleep(ALLO_DECAY_MS * 1100);
+    churn_slabs();
+    assert(a.stats.mmap_cache_bytes < cached);
+}
+
+int main(void) {
+    initialize_allocator(&a);
+
+    test_free_heaps_unmapped();
+    test_free_runs_purged();
+    test_mmap_cache_trimmed();
+    test_empty_slabs_reused();
+    test_transfer_cache_trimmed();
+    test_decay();
+    test_decay_repurges_used_heap();
+    test_decay_on_small_frees();
+
+    free_allocator(&a);
+    printf("Test passed: free memory was given back to the OS.\n");
+    return 0;
+}
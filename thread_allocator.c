@@ -0,0 +1,80 @@
+#include "thread_allocator.h"
+
+#include <pthread.h>
+#include <stddef.h>
+#include <sys/mman.h>
+
+#include "allo.h"
+
+static __thread allocator *thread_allocator;
+
+static pthread_key_t thread_allocator_key;
+static pthread_once_t thread_allocator_key_once = PTHREAD_ONCE_INIT;
+
+// only taken when threads start allocating or exit
+static pthread_mutex_t abandoned_lock = PTHREAD_MUTEX_INITIALIZER;
+static allocator *abandoned;
+
+static void abandon(void *arg) {
+    allocator *a = arg;
+    allo_reclaim_remote_frees(a);
+    thread_allocator = NULL;
+
+    pthread_mutex_lock(&abandoned_lock);
+    a->next_abandoned = abandoned;
+    abandoned = a;
+    pthread_mutex_unlock(&abandoned_lock);
+}
+
+static void make_key(void) {
+    pthread_key_create(&thread_allocator_key, abandon);
+}
+
+static allocator *adopt_or_create(void) {
+    pthread_mutex_lock(&abandoned_lock);
+    allocator *a = abandoned;
+    if (a != NULL) {
+        abandoned = a->next_abandoned;
+        a->next_abandoned = NULL;
+    }
+    pthread_mutex_unlock(&abandoned_lock);
+    if (a != NULL)
+        return a;
+
+    a = mmap(NULL, sizeof(allocator), PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (a == MAP_FAILED)
+        return NULL;
+    initialize_allocator(a);
+    return a;
+}
+
+allocator *allo_thread_allocator(void) {
+    if (thread_allocator != NULL)
+        return thread_allocator;
+
+    pthread_once(&thread_allocator_key_once, make_key);
+    allocator *a = adopt_or_create();
+    if (a == NULL)
+        return NULL;
+    pthread_setspecific(thread_allocator_key, a);
+    thread_allocator = a;
+    return a;
+}
+
+void *allo_thread_cate(size_t size) {
+    allocator *a = allo_thread_allocator();
+    return a == NULL ? NULL : allo_cate(a, size);
+}
+
+void allo_thread_free(void *p) {
+    if (p == NULL)
+        return;
+    allocator *owner = allo_owner(p);
+    if (owner == NULL)
+        return;
+    if (owner == thread_allocator)
+        allo_free(owner, p);
+    else
+        allo_free_remote(owner, p);
+}
@@ -0,0 +1,22 @@
+#ifndef THREAD_ALLOCATOR_H
+#define THREAD_ALLOCATOR_H
+
+#include <stddef.h>
+
+#include "allo.h"
+
+// Every thread gets an allocator of its own (heaps, free tree, arenas), so
+// allocation never synchronises. Memory freed by a thread that doesn't own it
+// is pushed onto the owner's lock-free remote free stack and reclaimed in bulk
+// the next time the owner allocates.
+//
+// When a thread exits its allocator is abandoned rather than freed, since
+// other threads may still hold its memory, and is adopted by the next thread
+// that needs one.
+
+allocator *allo_thread_allocator(void);
+
+void *allo_thread_cate(size_t size);
+void allo_thread_free(void *p);
+
+#endif
@@ -0,0 +1,131 @@
+#include "tlsf.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../allo.h"
+
+// sizes below this all live in the first level, in CHUNK_SIZE_ALIGN steps
+#define SMALL_SIZE (1 << TLSF_FL_SHIFT)
+
+static inline uint32_t fls_size(size_t size) {
+    return 63 - __builtin_clzll(size);
+}
+
+static void mapping_insert(size_t size, uint32_t *fl, uint32_t *sl) {
+    if (size < SMALL_SIZE) {
+        *fl = 0;
+        *sl = size / (SMALL_SIZE / TLSF_SL_COUNT);
+    } else {
+        uint32_t msb = fls_size(size);
+        *fl = msb - TLSF_FL_SHIFT + 1;
+        *sl = (size >> (msb - TLSF_SL_BITS)) ^ TLSF_SL_COUNT;
+    }
+}
+
+// bin whose chunks are all at least size big
+static void mapping_search(size_t size, uint32_t *fl, uint32_t *sl) {
+    if (size >= SMALL_SIZE)
+        size += (1ull << (fls_size(size) - TLSF_SL_BITS)) - 1;
+    mapping_insert(size, fl, sl);
+}
+
+void tlsf_init(tlsf_index *t) {
+    t->fl_bitmap = 0;
+    for (uint32_t fl = 0; fl < TLSF_FL_COUNT; fl++) {
+        t->sl_bitmap[fl] = 0;
+        for (uint32_t sl = 0; sl < TLSF_SL_COUNT; sl++)
+            t->bins[fl][sl] = NULL;
+    }
+}
+
+// the head of size's own bin if it happens to be big enough
+static node *search_own_bin(tlsf_index *t, size_t size) {
+    uint32_t fl, sl;
+    mapping_insert(size, &fl, &sl);
+    node *head = t->bins[fl][sl];
+    return head && SIZE(head) >= size ? head : NULL;
+}
+
+node *tlsf_search(tlsf_index *t, size_t size) {
+    uint32_t fl, sl;
+    mapping_search(size, &fl, &sl);
+    if (fl >= TLSF_FL_COUNT)
+        return search_own_bin(t, size);
+
+    uint32_t sl_map = t->sl_bitmap[fl] & (~0u << sl);
+    if (sl_map == 0) {
+        uint32_t fl_map = t->fl_bitmap & (~0u << (fl + 1));
+        if (fl_map == 0)
+            return search_own_bin(t, size);
+        fl = __builtin_ctz(fl_map);
+        sl_map = t->sl_bitmap[fl];
+    }
+    sl = __builtin_ctz(sl_map);
+    return t->bins[fl][sl];
+}
+
+void tlsf_insert(tlsf_index *t, node *node) {
+    uint32_t fl, sl;
+    mapping_insert(SIZE(node), &fl, &sl);
+
+    free_chunk_list *l = (free_chunk_list *)node;
+    free_chunk_list *head = (free_chunk_list *)t->bins[fl][sl];
+    l->status |= FREE;
+    l->prev_of_size = NULL;
+    l->next_of_size = head;
+    if (head)
+        head->prev_of_size = node;
+    t->bins[fl][sl] = node;
+    t->fl_bitmap |= 1u << fl;
+    t->sl_bitmap[fl] |= 1u << sl;
+}
+
+void tlsf_remove(tlsf_index *t, node *node) {
+    free_chunk_list *l = (free_chunk_list *)node;
+    if (l->next_of_size)
+        l->next_of_size->prev_of_size = l->prev_of_size;
+    if (l->prev_of_size) {
+        ((free_chunk_list *)l->prev_of_size)->next_of_size = l->next_of_size;
+        return;
+    }
+
+    uint32_t fl, sl;
+    mapping_insert(SIZE(node), &fl, &sl);
+    t->bins[fl][sl] = (free_chunk *)l->next_of_size;
+    if (t->bins[fl][sl] == NULL) {
+        t->sl_bitmap[fl] &= ~(1u << sl);
+        if (t->sl_bitmap[fl] == 0)
+            t->fl_bitmap &= ~(1u << fl);
+    }
+}
+
+bool tlsf_contains(tlsf_index *t, node *node) {
+    uint32_t fl, sl;
+    mapping_insert(SIZE(node), &fl, &sl);
+    for (free_chunk_list *l = (free_chunk_list *)t->bins[fl][sl]; l != NULL;
+         l = l->next_of_size)
+        if ((void *)l == (void *)node)
+            return true;
+    return false;
+}
+
+void tlsf_debug_print(tlsf_index *t) {
+#ifdef __ALLO_DEBUG_PRINT
+    debug_printf("TLSF:\n");
+    for (uint32_t fl = 0; fl < TLSF_FL_COUNT; fl++) {
+        for (uint32_t sl = 0; sl < TLSF_SL_COUNT; sl++) {
+            if (t->bins[fl][sl] == NULL)
+                continue;
+            debug_printf("  [%u][%u]:", fl, sl);
+            for (free_chunk_list *l = (free_chunk_list *)t->bins[fl][sl];
+                 l != NULL; l = l->next_of_size)
+                debug_printf(" (%zu, %p)", CHUNK_SIZE(l->status), (void *)l);
+            debug_printf("\n");
+        }
+    }
+    debug_printf("END TLSF:\n");
+#else
+    (void)t;
+#endif
+}
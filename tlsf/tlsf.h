@@ -0,0 +1,29 @@
+#ifndef TLSF_H
+#define TLSF_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../allo.h"
+
+// Two level segregated fit index of free heap chunks. The first level splits
+// sizes by power of two, the second splits each power of two into
+// TLSF_SL_COUNT linear bins, and a bitmap per level finds the first non empty
+// bin that fits with __builtin_ctz. Search, insert and remove are all O(1).
+//
+// Chunks are linked into their bin through the free_chunk_list fields.
+
+typedef free_chunk node;
+
+void tlsf_init(tlsf_index *t);
+// a chunk of size >= size, without removing it. the search rounds size up
+// to the next bin, and only falls back to the head of size's own bin, so it
+// can miss a fitting chunk further down that bin
+node *tlsf_search(tlsf_index *t, size_t size);
+void tlsf_insert(tlsf_index *t, node *node);
+void tlsf_remove(tlsf_index *t, node *node);
+bool tlsf_contains(tlsf_index *t, node *node);
+void tlsf_debug_print(tlsf_index *t);
+
+#endif
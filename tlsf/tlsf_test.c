@@ -0,0 +1,83 @@
+#include <assert.h>
+#include <stdio.h>
+
+#include "../allo.h"
+#include "tlsf.h"
+
+#define TEST_SIZE 1000
+
+// room for the list links in front of each node's size
+typedef struct test_node {
+    free_chunk_list list;
+} test_node;
+
+test_node nodes[TEST_SIZE];
+
+size_t test_size(unsigned i) { return (i + 1) * 32 * 3; }
+
+void test_tlsf_insert(void) {
+    tlsf_index t;
+    tlsf_init(&t);
+
+    for (unsigned i = 0; i < TEST_SIZE; i++) {
+        nodes[i].list.status = test_size(i);
+        tlsf_insert(&t, (node *)&nodes[i]);
+    }
+
+    for (unsigned i = 0; i < TEST_SIZE; i++) {
+        assert(tlsf_contains(&t, (node *)&nodes[i]));
+        node *found = tlsf_search(&t, test_size(i));
+        assert(found && SIZE(found) >= test_size(i));
+    }
+    assert(tlsf_search(&t, test_size(TEST_SIZE - 1) + 32) == NULL);
+}
+
+void test_tlsf_remove(void) {
+    tlsf_index t;
+    tlsf_init(&t);
+
+    for (unsigned i = 0; i < TEST_SIZE; i++) {
+        nodes[i].list.status = test_size(i);
+        tlsf_insert(&t, (node *)&nodes[i]);
+    }
+
+    // from the largest down, so the largest left is always i
+    for (unsigned i = TEST_SIZE; i-- > 0;) {
+        node *found = tlsf_search(&t, test_size(i) / 2);
+        assert(found && SIZE(found) >= test_size(i) / 2);
+        tlsf_remove(&t, (node *)&nodes[i]);
+        assert(!tlsf_contains(&t, (node *)&nodes[i]));
+        found = tlsf_search(&t, test_size(i));
+        assert(found == NULL);
+    }
+    assert(t.fl_bitmap == 0);
+}
+
+void test_tlsf_same_size(void) {
+    tlsf_index t;
+    tlsf_init(&t);
+
+    for (unsigned i = 0; i < TEST_SIZE; i++) {
+        nodes[i].list.status = 4096;
+        tlsf_insert(&t, (node *)&nodes[i]);
+    }
+    // out of order removal from the middle of a bin
+    for (unsigned i = 0; i < TEST_SIZE; i += 2)
+        tlsf_remove(&t, (node *)&nodes[i]);
+    for (unsigned i = 1; i < TEST_SIZE; i += 2) {
+        assert(tlsf_search(&t, 4096) != NULL);
+        tlsf_remove(&t, (node *)&nodes[i]);
+    }
+    assert(tlsf_search(&t, 4096) == NULL);
+}
+
+int main(void) {
+    test_tlsf_insert();
+    printf("Passed insert\n");
+    test_tlsf_remove();
+    printf("Passed remove\n");
+    test_tlsf_same_size();
+    printf("Passed same size\n");
+    printf("All tests passed!\n");
+    return 0;
+}